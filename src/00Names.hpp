@@ -6,7 +6,7 @@
 
 extern std::filesystem::path libdirPath;
 extern std::string platform, configuration;
-extern bool rebuild;
+extern bool rebuild, pruneStale;
 
 std::unordered_map<std::string, std::vector<std::string>> parseFile(const std::string& filename);
 std::vector<std::string> buildModule(const std::filesystem::path& buildfile, bool& skip);
@@ -14,21 +14,118 @@ std::vector<std::string> buildModule(const std::filesystem::path& buildfile, boo
 /*          WILDCARD          */
 std::string replace(std::string str, const std::string& from, const std::string& to);
 bool wildcardMatch(const std::string& str, const std::string& pattern);
-std::vector<std::string> wildcard(const std::string& pattern, bool dir = false);
+std::vector<std::string> wildcard(const std::string& pattern, bool dir = false, const std::vector<std::string>& exclude = {});
+std::vector<std::string> wildcards(const std::vector<std::string>& patterns, bool dir = false);
 
 /*          PACKAGE MANAGER          */
-void searchPackage(const std::string& name);
-void installPackage(const std::string& name);
+void searchPackage(const std::string& name, const std::vector<std::string>& languages, const std::string& license, bool offline, double ttl);
+void importPackages(const std::string& dump);
+void packLibrary(const std::string& name, std::string archive);
+void unpackLibrary(const std::string& archive);
+void installPackages(std::vector<std::string> names, const std::string& mirror, bool update);
 
 /*          EXEC          */
 inline std::string getFilename(std::string path) { return path.find_last_of("/\\") == std::string::npos ? path : path.substr(path.find_last_of("/\\") + 1); }
 std::filesystem::path getProgramPath();
-inline uint64_t lastModified(const std::filesystem::path& filename) {
-  if (!std::filesystem::exists(filename)) return 0;
-  return std::filesystem::last_write_time(filename).time_since_epoch().count();
-}
+uint64_t lastModified(const std::filesystem::path& filename);
+void prefetchModified(const std::vector<std::string>& filenames);
+void forgetModified();
 
 bool execute(std::string command);
+int runProgram(const std::filesystem::path& program, const std::vector<std::string>& arguments);
+std::string executeWOut(const std::string& command);
+std::string hashData(const std::string& data);
+std::string hashFile(const std::filesystem::path& path);
+
+/*          METADATA          */
+uint64_t statModified(const std::string& path);
+std::vector<uint64_t> statModified(const std::vector<std::string>& paths);
+
+/*          STAMP          */
+void writeStamp(const std::filesystem::path& stampFile, const std::string& key, const std::string& output);
+std::string freshStamp(const std::filesystem::path& stampFile, const std::string& key);
+
+/*          JOBS          */
+// Scratch jobs make throwaway outputs, they aren't kept in the history
+enum class JobKind { Compile, Link, Fetch, Scratch };
+extern unsigned jobCount, linkJobCount;
+extern double maxLoad;
+extern uint64_t maxMemory;
+
+uint64_t parseSize(const std::string& size);
+void initJobs(const std::filesystem::path& historyFile);
+extern bool explain, dryRun;
+
+size_t addJob(const std::string& command, const std::string& output, const std::string& reason, JobKind kind = JobKind::Compile, const std::vector<size_t>& deps = {});
+bool commandChanged(const std::string& output, const std::string& command);
+void restatJob(size_t job, const std::vector<std::string>& inputs);
+void sizeJob(size_t job, uint64_t bytes);
+bool runJobs();
+void discardJobs();
+
+struct PlannedJob {
+  std::string command, output;
+  std::filesystem::path directory;
+};
+
+std::vector<PlannedJob> plannedJobs(JobKind kind);
+uint64_t recordedDuration(const std::string& output);
+
+/*          PGO          */
+extern bool instrument;
+std::string instrumentFlags(const std::filesystem::path& buildDir, bool clang);
+std::string profileFlags(const std::filesystem::path& buildDir, bool clang);
+std::filesystem::path profileData(const std::filesystem::path& buildDir, const std::filesystem::path& object, bool clang);
+void planTraining(const std::string& command, const std::filesystem::path& buildDir, const std::filesystem::path& profileBuildDir, bool clang);
+bool trainProfiles();
+
+/*          MODULES          */
+struct ModuleScan {
+  std::string provides;
+  std::vector<std::string> imports;
+};
+
+ModuleScan scanModules(const std::string& file, const std::string& compile, const std::filesystem::path& object, bool clang);
+std::vector<size_t> moduleOrder(const std::vector<ModuleScan>& scans);
+
+/*          INCLUDE SCANNER          */
+struct IncludeScan {
+  std::vector<std::string> headers;
+  uint64_t bytes = 0;
+};
+
+IncludeScan scanIncludes(const std::string& file, const std::vector<std::string>& includes);
+
+/*          ANALYZE          */
+void analyzeIncludes(const std::vector<PlannedJob>& compiles, size_t top);
+
+/*          REMOTE          */
+struct RemoteAction {
+  std::string preprocess, compile, output, extension;
+};
+
+extern std::vector<std::string> remoteWorkers;
+void runWorker(const std::string& address, const std::filesystem::path& cache);
+int remoteCompile(const RemoteAction& action, const std::string& worker);
+void offloadJob(size_t job, const RemoteAction& action);
+
+/*          STATS          */
+enum class Phase { Other, Parse, Glob, Stat, Scan, Commands, Compile, Link, Count };
+enum class Counter { Entries, Matches, Stats, Scanned, Processes, CommandBytes, Count };
+extern bool showStats;
+
+// Attributes the time until it's destroyed to a phase, and to a glob pattern if given
+struct PhaseTimer {
+  PhaseTimer(Phase phase, const std::string& pattern = "");
+  ~PhaseTimer();
+
+  Phase previous;
+  std::string pattern;
+  double start = 0;
+};
+
+void count(Counter counter, uint64_t amount = 1);
+void printStats();
 
 /*          ERRORS          */
 template <typename... Args> void error(FILE* file, Args... args) {
@@ -0,0 +1,89 @@
+#include "00Names.hpp"
+#include <fstream>
+#include <regex>
+#include <map>
+#include <set>
+#include <algorithm>
+
+/*          ANALYZE          */
+// `analyze includes` preprocesses every source with -H, which prints the tree of headers it opens. Each header is charged
+// with the bytes it pulls into every source, directly or through its own includes, and their share of the recorded compile time.
+
+struct HeaderCost {
+  size_t sources = 0;
+  uint64_t size = 0, bytes = 0;
+  double milliseconds = 0;
+};
+
+static uint64_t fileSize(const std::filesystem::path& path) {
+  std::error_code error;
+  const auto size = std::filesystem::file_size(path, error);
+  return error ? 0 : size;
+}
+
+void analyzeIncludes(const std::vector<PlannedJob>& compiles, size_t top) {
+  const auto trees = std::filesystem::absolute("build") / "analyze";
+  std::filesystem::create_directories(trees);
+
+  // * Preprocess through the scheduler, so it runs in parallel. Sources that fail still leave the part of the tree they got through
+  printf("Preprocessing %zu sources\n", compiles.size());
+  const auto originalPath = std::filesystem::current_path();
+  static const std::regex output(R"( -o \S+)");
+  for (const auto& compile : compiles) {
+    std::filesystem::current_path(compile.directory);
+    const std::string command = std::regex_replace(replace(compile.command, " -c ", " -E -H "), output, " -o /dev/null", std::regex_constants::format_first_only);
+    const auto tree = trees / (hashData(compile.output) + ".tree");
+    addJob("@" + command + " 2> " + tree.string() + "; true", tree.string(), "include tree", JobKind::Scratch);
+  }
+  std::filesystem::current_path(originalPath);
+  runJobs();
+
+  std::map<std::filesystem::path, HeaderCost> headers;
+  bool timed = false;
+  for (const auto& compile : compiles) {
+    std::ifstream tree(trees / (hashData(compile.output) + ".tree"));
+
+    // * Lines are ". header", with a dot per level of nesting
+    std::vector<std::pair<std::filesystem::path, uint64_t>> open, closed;
+    uint64_t total = 0;
+    const auto close = [&] {
+      closed.push_back(open.back());
+      open.pop_back();
+      if (!open.empty()) open.back().second += closed.back().second;
+      else total += closed.back().second;
+    };
+    for (std::string line; std::getline(tree, line);) {
+      const size_t depth = line.find_first_not_of('.');
+      if (depth == 0 || depth == std::string::npos || line[depth] != ' ') continue;
+      while (open.size() >= depth) close();
+      const auto header = (compile.directory / line.substr(depth + 1)).lexically_normal();
+      open.emplace_back(header, fileSize(header));
+    }
+    while (!open.empty()) close();
+
+    const uint64_t duration = recordedDuration(compile.output);
+    timed |= duration != 0;
+    std::set<std::filesystem::path> counted;
+    for (const auto& [header, bytes] : closed) {
+      HeaderCost& cost = headers[header];
+      if (counted.insert(header).second) cost.sources++;
+      cost.size = fileSize(header);
+      cost.bytes += bytes;
+      if (duration && total) cost.milliseconds += double(bytes) / total * duration;
+    }
+  }
+  std::filesystem::remove_all(trees);
+
+  // * Rank by the time the header costs, or the bytes it pulls in if no build was timed yet
+  std::vector<std::pair<std::filesystem::path, HeaderCost>> ranking(headers.begin(), headers.end());
+  std::sort(ranking.begin(), ranking.end(), [&](const auto& a, const auto& b) { return timed ? a.second.milliseconds > b.second.milliseconds : a.second.bytes > b.second.bytes; });
+  if (ranking.size() > top) ranking.resize(top);
+
+  printf("%8s %10s %12s %10s  %s\n", "Sources", "Size", "Pulled in", "Est. time", "Header");
+  for (const auto& [header, cost] : ranking) {
+    const auto relative = header.lexically_proximate(originalPath);
+    const auto name = relative.empty() || *relative.begin() == ".." ? header : relative;
+    printf("%8zu %9.1fK %11.1fM %8.0fms  %s\n", cost.sources, cost.size / 1024.0, cost.bytes / 1048576.0, cost.milliseconds, name.generic_string().c_str());
+  }
+  if (!timed) puts("No compile times recorded yet, build once to estimate the time each header costs.");
+}
@@ -1,15 +1,97 @@
 #include "00Names.hpp"
 #include <set>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <climits>
+#include <thread>
 
 static std::set<std::string> objects;
 static std::vector<std::string> linkerFlags;
+static std::vector<size_t> compileJobs;
+static std::string relinkReason;
 static bool relink, skip;
-bool rebuild = false;
+bool rebuild = false, pruneStale = false;
+
+// * "'a' is 1.5s newer than 'b'", for --explain
+static std::string newer(const std::filesystem::path& file, const std::filesystem::path& than) {
+  using Period = std::filesystem::file_time_type::period;
+  const double seconds = double(lastModified(file) - lastModified(than)) * Period::num / Period::den;
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.3fs", seconds);
+  return "'" + file.generic_string() + "' is " + buffer + " newer than '" + than.generic_string() + "'";
+}
+
+// * Outputs of the module this buildfile produces, anything else in the build directory is stale
+static void writeManifest(const std::filesystem::path& buildDir, const std::vector<std::filesystem::path>& manifest) {
+  std::ofstream file(buildDir / "manifest");
+  for (const auto& output : manifest) file << output.generic_string() << '\n';
+}
+
+// * True if an object was removed, the output still has its code then
+static bool pruneOutputs(const std::filesystem::path& buildDir, const std::vector<std::filesystem::path>& manifest) {
+  if (!std::filesystem::exists(buildDir)) return false;
+  // * The linker and the profiler manage these directories themselves
+  const std::set<std::filesystem::path> preserve = {buildDir / "thinlto-cache", buildDir / "profile", buildDir / "profile-raw"};
+  std::set<std::filesystem::path> keep = {buildDir / "manifest", buildDir / "variant"};
+  keep.insert(preserve.begin(), preserve.end());
+  for (const auto& output : manifest) {
+    // * Keep the directories leading to outputs too, the compiler expects them
+    for (auto path = output.lexically_normal(); path.has_relative_path() && keep.insert(path).second;) path = path.parent_path();
+  }
+  std::vector<std::filesystem::path> stale, directories;
+  for (std::filesystem::recursive_directory_iterator i(buildDir), end; i != end; i++) {
+    if (preserve.count(i->path())) i.disable_recursion_pending();
+    if (keep.count(i->path().lexically_normal())) continue;
+    if (i->is_directory()) directories.push_back(i->path());
+    else stale.push_back(i->path());
+  }
+  bool objectRemoved = false;
+  for (const auto& path : stale) {
+    printf("Removing stale '%s'\n", path.generic_string().c_str());
+    std::filesystem::remove(path);
+    objectRemoved |= path.extension() == ".o";
+  }
+
+  // * Deepest first, so emptied parents go too
+  std::sort(directories.rbegin(), directories.rend());
+  for (const auto& directory : directories) {
+    if (std::filesystem::is_empty(directory)) std::filesystem::remove(directory);
+  }
+  return objectRemoved;
+}
+
+// * Objects mirror the source tree, so sources with the same name don't share an object.
+// * Sources outside the module directory get a directory named after a hash of their path instead.
+static std::filesystem::path objectPath(const std::filesystem::path& buildDir, const std::string& file) {
+  const auto relative = std::filesystem::path(file).lexically_normal();
+  if (relative.is_absolute() || *relative.begin() == "..") {
+    return buildDir / "external" / hashData(std::filesystem::absolute(relative).lexically_normal().generic_string()) / (relative.filename().string() + ".o");
+  }
+  return buildDir / (relative.string() + ".o");
+}
+
+static std::string compilerIdentity(const std::string& compiler) {
+  static std::unordered_map<std::string, std::string> identities;
+  if (!identities.count(compiler)) {
+    const std::string version = executeWOut(compiler + " --version 2>&1");
+    identities[compiler] = version.substr(0, version.find('\n'));
+  }
+  return identities[compiler];
+}
+
+static bool toolAvailable(const std::string& tool) {
+  static std::unordered_map<std::string, bool> available;
+  if (!available.count(tool)) available[tool] = !executeWOut("command -v " + tool + " 2>&1").empty();
+  return available[tool];
+}
+
+static bool hasExtension(const std::string& path, const std::string& extension) { return std::filesystem::path(path).extension() == extension; }
 
 std::vector<std::string> buildModule(const std::filesystem::path& buildfile, bool& skip) {
   // * Files & Names
-  if (!std::filesystem::exists(buildfile)) error("Buildfile '%s' not found!", buildfile.c_str());
+  if (!lastModified(buildfile)) error("Buildfile '%s' not found!", buildfile.c_str());
   const auto originalPath = std::filesystem::current_path();
   std::filesystem::current_path(buildfile.parent_path());
 
@@ -28,42 +110,31 @@ std::vector<std::string> buildModule(const std::filesystem::path& buildfile, boo
   if (!properties.count("flags")) properties["flags"] = {};
 
   // * Apply wildcards and gather files
-  std::vector<std::string> files, watch, includes;
-  for (const auto& pattern : properties["files"]) {
-    std::vector<std::string> filesFound = wildcard(pattern);
-    files.insert(files.end(), filesFound.begin(), filesFound.end());
-  }
-  for (const auto& pattern : properties["watch"]) {
-    std::vector<std::string> watchFound = wildcard(pattern);
-    watch.insert(watch.end(), watchFound.begin(), watchFound.end());
-  }
-  for (const auto& pattern : properties["include"]) {
-    std::vector<std::string> includesFound = wildcard(pattern);
-    includes.insert(includes.end(), includesFound.begin(), includesFound.end());
-  }
+  std::vector<std::string> files = wildcards(properties["files"]), watch = wildcards(properties["watch"]), includes = wildcards(properties["include"]);
 
   // * Dependencies
   if (link) {
     objects.clear();
     linkerFlags.clear();
+    compileJobs.clear();
+    relinkReason.clear();
     relink = false;
   }
 
   if (properties.count("linkerFlags")) linkerFlags.insert(linkerFlags.end(), properties["linkerFlags"].begin(), properties["linkerFlags"].end());
 
   std::vector<std::string> localIncludes;
+  std::string reason = rebuild ? "rebuild requested" : "";
   skip = !rebuild;
   for (const auto& library : properties["library"]) {
     auto path = libdirPath / library / "library.orebuild";
-    if (!std::filesystem::exists(path)) continue; // TODO: optional dependencies
+    if (!lastModified(path)) continue; // TODO: optional dependencies
 
     bool skipModule = true;
     std::vector<std::string> newIncludes = buildModule(std::filesystem::absolute(path), skipModule);
+    if (!skipModule && skip) reason = "library '" + library + "' rebuilt";
     if (!skipModule) skip = false;
     localIncludes.insert(localIncludes.end(), newIncludes.begin(), newIncludes.end());
-    for (const auto& object : std::filesystem::directory_iterator(libdirPath / library / "build" / platform / configuration)) {
-      objects.insert(std::filesystem::absolute(object.path()).string());
-    }
   }
 
   // * Get the compile commands
@@ -72,35 +143,193 @@ std::vector<std::string> buildModule(const std::filesystem::path& buildfile, boo
   if (compiler.substr(compiler.size() - 2) == "cc") std::replace(cxxCompiler.end() - 2, cxxCompiler.end(), 'c', '+');
   else cxxCompiler += "++";
 
+  // * Debug info: full, split into .dwo files next to the objects, packaged (split, then a .dwp after linking), compressed or none
+  const std::string debugInfo = properties.count("debugInfo") ? properties["debugInfo"][0] : "none";
+  const bool debugPackage = debugInfo == "packaged", splitDwarf = debugInfo == "split" || debugPackage;
+  if (debugInfo == "full") properties["flags"].push_back("-g");
+  else if (splitDwarf) properties["flags"].push_back("-g -gsplit-dwarf");
+  else if (debugInfo == "compressed") {
+    properties["flags"].push_back("-g -gz");
+    linkerFlags.push_back("-gz");
+  } else if (debugInfo != "none") error("Unknown debugInfo '%s', expected full, split, packaged, compressed or none!\n", debugInfo.c_str());
+
+  // * Link time optimization: off, full or thin. GCC has no ThinLTO, so thin is full LTO there
+  const std::string lto = properties.count("lto") ? properties["lto"][0] : "off";
+  const bool clang = compilerIdentity(compiler).find("clang") != std::string::npos;
+  if (lto == "full") properties["flags"].push_back("-flto");
+  else if (lto == "thin") properties["flags"].push_back(clang ? "-flto=thin" : "-flto");
+  else if (lto != "off") error("Unknown lto '%s', expected off, full or thin!\n", lto.c_str());
+
+  // * Code layout from a profile of the program: perf.data or a BOLT .fdata for llvm-bolt, without it or with a .txt list of hot functions gold orders them first
+  const std::string layoutProfile = link && !instrument && properties.count("layout") ? properties["layout"][0] : "";
+  const bool bolt = !layoutProfile.empty() && !hasExtension(layoutProfile, ".txt") && toolAvailable("llvm-bolt");
+  if (!layoutProfile.empty() && !bolt) properties["flags"].push_back("-ffunction-sections");
+  if (!layoutProfile.empty() && !bolt && hasExtension(layoutProfile, ".fdata")) error("Layout profile '%s' needs llvm-bolt!\n", layoutProfile.c_str());
+
+  // * Libraries keep a build directory per variant, so every project asking for the same compiler and flags shares the objects
+  auto buildDir = std::filesystem::path("build") / platform / configuration;
+  std::string variant = "platform " + platform + "\nconfiguration " + configuration + "\ncompiler " + compilerIdentity(compiler) + "\ncxxCompiler " + compilerIdentity(cxxCompiler) + "\nflags ";
+  for (const auto& flag : properties["flags"]) variant += flag + ' ';
+  if (!link) buildDir /= hashData(variant);
+
+  // * Profile guided optimization, instrumented builds get their own directory
+  const auto profileBuildDir = buildDir;
+  std::string profile;
+  if (link && instrument) {
+    buildDir += "-instrumented";
+    if (properties.count("output")) properties["output"] = {(buildDir / getFilename(properties["output"][0])).generic_string()};
+    properties["flags"].push_back(instrumentFlags(buildDir, clang));
+    linkerFlags.push_back(instrumentFlags(buildDir, clang));
+  } else if (link) {
+    profile = profileFlags(buildDir, clang);
+    if (!profile.empty()) properties["flags"].push_back(profile);
+  }
+
   // * Check for skips
-  if (!std::filesystem::exists(std::filesystem::path("build") / platform / configuration)) {
-    std::filesystem::create_directories(std::filesystem::path("build") / platform / configuration);
+  if (!std::filesystem::exists(buildDir)) {
+    if (!dryRun) std::filesystem::create_directories(buildDir);
+    if (!link && !dryRun) std::ofstream(buildDir / "variant") << variant << '\n';
+    if (skip) reason = "build directory '" + buildDir.generic_string() + "' missing";
     skip = false;
   }
 
-  if (skip) {
-    for (const auto& file : watch) {
-      if (lastModified(file) >= lastModified(std::filesystem::path("build") / platform / configuration)) {
-        skip = false;
-        break;
+  std::string includeFlags, flags;
+  for (const auto& include : includes) includeFlags += "-I" + include + ' ';
+  for (const auto& include : localIncludes) includeFlags += "-I" + include + ' ';
+  for (const auto& flag : properties["flags"]) flags += flag + ' ';
+
+  // * Module interfaces aren't known to the compilers by their extension
+  const auto isInterface = [](const std::string& file) { return hasExtension(file, ".cppm") || hasExtension(file, ".ixx"); };
+  const auto driverFor = [&](const std::string& file) { return hasExtension(file, ".cpp") || isInterface(file) ? cxxCompiler : compiler; };
+  const auto sourceFor = [&](const std::string& file) { return isInterface(file) ? (clang ? "-x c++-module " : "-x c++ ") + file : file; };
+
+  // * Importers are planned after the modules they use, so they can wait for the interfaces
+  std::vector<std::filesystem::path> manifest;
+  std::vector<ModuleScan> scans;
+  std::map<std::string, std::filesystem::path> interfaces;
+  // * Everything the checks below look at, stated at once
+  std::vector<std::string> checked = watch;
+  for (const auto& file : files) {
+    const auto object = objectPath(buildDir, file);
+    checked.insert(checked.end(), {file, object.string(), std::filesystem::path(object).replace_extension(".ddi").string()});
+  }
+  prefetchModified(checked);
+
+  std::vector<IncludeScan> headerScans;
+  std::set<std::string> scannedHeaders;
+  std::vector<std::string> includePaths = includes;
+  includePaths.insert(includePaths.end(), localIncludes.begin(), localIncludes.end());
+  std::istringstream flagStream(flags);
+  for (std::string flag; flagStream >> flag;) {
+    if (flag == "-I" || flag == "-iquote") flagStream >> flag;
+    else if (flag.compare(0, 2, "-I") == 0) flag = flag.substr(2);
+    else continue;
+    includePaths.push_back(flag);
+  }
+  for (const auto& file : files) {
+    const auto object = objectPath(buildDir, file);
+    headerScans.push_back(scanIncludes(file, includePaths));
+    scannedHeaders.insert(headerScans.back().headers.begin(), headerScans.back().headers.end());
+    scans.push_back(scanModules(file, driverFor(file) + " -c " + sourceFor(file) + " -o " + object.generic_string() + ' ' + includeFlags + flags, object, clang));
+    if (!scans.back().provides.empty()) interfaces[scans.back().provides] = buildDir / "modules" / (replace(scans.back().provides, ":", "-") + (clang ? ".pcm" : ".gcm"));
+  }
+  if (!interfaces.empty()) {
+    if (!dryRun) std::filesystem::create_directories(buildDir / "modules");
+    for (const auto& [name, interface] : interfaces) manifest.push_back(interface);
+  }
+  if (!interfaces.empty() && clang) flags += "-fprebuilt-module-path=" + std::filesystem::absolute(buildDir / "modules").string() + ' ';
+  if (!interfaces.empty() && !clang) {
+    // * GCC finds interfaces through a mapper file
+    std::string mapper;
+    for (const auto& [name, interface] : interfaces) mapper += name + ' ' + std::filesystem::absolute(interface).string() + '\n';
+    if (!dryRun) std::ofstream(buildDir / "modules.map") << mapper;
+    manifest.push_back(buildDir / "modules.map");
+    flags += "-fmodules-ts -fmodule-mapper=" + std::filesystem::absolute(buildDir / "modules.map").string() + ' ';
+  }
+
+  // * Headers the scanner found only recompile the sources including them, other watched files recompile every object older than them
+  std::string newestWatched;
+  for (const auto& file : watch) {
+    if (scannedHeaders.count(std::filesystem::absolute(file).lexically_normal().string())) continue;
+    if (newestWatched.empty() || lastModified(file) > lastModified(newestWatched)) newestWatched = file;
+  }
+  bool watchedChanged = false;
+  const auto newerHeader = [](const IncludeScan& scan, const std::filesystem::path& object) -> std::string {
+    for (const auto& header : scan.headers) {
+      if (lastModified(header) >= lastModified(object)) return header;
+    }
+    return "";
+  };
+
+  // * Recompile some objects
+  std::map<std::string, size_t> interfaceJobs;
+  for (const size_t index : moduleOrder(scans)) {
+    PhaseTimer timer(Phase::Commands);
+    const auto& file = files[index];
+    const auto& scan = scans[index];
+    const auto object = objectPath(buildDir, file);
+    manifest.push_back(object);
+    manifest.push_back(std::filesystem::path(object).replace_extension(".ddi"));
+    if (splitDwarf) manifest.push_back(std::filesystem::path(object).replace_extension(".dwo"));
+    objects.insert(std::filesystem::absolute(object).string());
+    const std::string driver = driverFor(file);
+
+    // * Clang is told where each interface goes, it finds the imported ones and theirs in the modules directory
+    std::string moduleFlags;
+    std::vector<size_t> deps;
+    std::string rebuiltModule;
+    if (clang && !scan.provides.empty()) moduleFlags += "-fmodule-output=" + interfaces[scan.provides].generic_string() + ' ';
+    for (const auto& name : scan.imports) {
+      if (!interfaces.count(name)) continue;
+      if (interfaceJobs.count(name)) {
+        deps.push_back(interfaceJobs[name]);
+        rebuiltModule = name;
+      }
+    }
+    const std::string command = driver + " -c " + sourceFor(file) + " -o " + object.generic_string() + ' ' + includeFlags + flags + moduleFlags;
+
+    std::string fileReason = reason;
+    if (skip) {
+      if (!lastModified(object)) fileReason = "'" + object.generic_string() + "' missing";
+      else if (!scan.provides.empty() && !lastModified(interfaces[scan.provides])) fileReason = "'" + interfaces[scan.provides].generic_string() + "' missing";
+      else if (lastModified(file) >= lastModified(object)) fileReason = newer(file, object);
+      else if (const std::string header = newerHeader(headerScans[index], object); !header.empty()) fileReason = "header " + newer(header, object);
+      else if (!newestWatched.empty() && lastModified(newestWatched) >= lastModified(object)) {
+        fileReason = "watched " + newer(newestWatched, object);
+        watchedChanged = true;
       }
+      else if (!rebuiltModule.empty()) fileReason = "module '" + rebuiltModule + "' rebuilt";
+      else if (!profile.empty() && lastModified(profileData(buildDir, object, clang)) >= lastModified(object)) fileReason = "profile " + newer(profileData(buildDir, object, clang), object);
+      else if (commandChanged(object.string(), command)) fileReason = "command changed";
+      else continue;
+    }
+
+    if (!dryRun) std::filesystem::create_directories(object.parent_path());
+    compileJobs.push_back(addJob(command, object.string(), fileReason, JobKind::Compile, deps));
+    sizeJob(compileJobs.back(), headerScans[index].bytes);
+    if (!scan.provides.empty()) interfaceJobs[scan.provides] = compileJobs.back();
+    // * Workers only get preprocessed sources, which can't carry module interfaces, and send back only the object, not the .dwo.
+    // Profiles are named after the object path, which is a temporary one on the worker
+    const bool profiled = (link && instrument) || !profile.empty();
+    if (!remoteWorkers.empty() && scan.provides.empty() && scan.imports.empty() && !splitDwarf && !profiled) {
+      const std::string extension = driver == cxxCompiler ? ".ii" : ".i";
+      offloadJob(compileJobs.back(), RemoteAction{driver + " -E " + file + ' ' + includeFlags + flags, driver + " -c $in -o $out " + flags, object.string(), extension});
     }
+    relinkReason = relinkReason.empty() ? "'" + object.generic_string() + "' recompiled" : "objects recompiled";
+    relink = true;
   }
+  // * Modules using this one can't tell which of its unscanned watched files they include either
+  if (watchedChanged) skip = false;
 
-  // * Recompile some objects
-  for (const auto& file : files) {
-    if (skip && lastModified(file) < lastModified(std::filesystem::path("build") / platform / configuration / (getFilename(files[0]) + ".o"))) continue;
-    std::string command = compiler + " -c ";
-    if (file.substr(file.size() - 4) == ".cpp") command = cxxCompiler + " -c ";
-    command += file + ' ';
-    command += "-o build/";
-    command += platform + '/';
-    command += configuration + '/';
-    command += getFilename(file) + ".o" + ' ';
-    for (const auto& include : includes) command += "-I" + include + ' ';
-    for (const auto& include : localIncludes) command += "-I" + include + ' ';
-    for (const auto& flag : properties["flags"]) command += flag + ' ';
-    if (!execute(command)) exit(-1);
+  // * Outputs may live in the build directory too
+  if (link && properties.count("output")) manifest.push_back(properties["output"][0]);
+  if (link && debugPackage && properties.count("output")) manifest.push_back(properties["output"][0] + ".dwp");
+  if (bolt && properties.count("output")) manifest.push_back(buildDir / getFilename(properties["output"][0]));
+  if (bolt) manifest.push_back(buildDir / "layout.fdata");
+  else if (!layoutProfile.empty()) manifest.push_back(buildDir / "layout.order");
+  if (!dryRun) writeManifest(buildDir, manifest);
+  if (pruneStale && pruneOutputs(buildDir, manifest)) {
+    if (!relink) relinkReason = "stale objects removed";
     relink = true;
   }
 
@@ -111,25 +340,95 @@ std::vector<std::string> buildModule(const std::filesystem::path& buildfile, boo
     return includes;
   }
 
-  for (const auto& object : std::filesystem::directory_iterator(std::filesystem::path(buildfile).parent_path() / "build" / platform / configuration)) {
-    objects.insert(std::filesystem::absolute(object.path()).string());
+  if (!properties.count("output")) error("No output specified!");
+  if (instrument) {
+    const std::string train = properties.count("train") ? properties["train"][0] : "$out";
+    planTraining(replace(train, "$out", properties["output"][0]), buildDir, profileBuildDir, clang);
   }
 
-  if (!properties.count("output")) error("No output specified!");
-  if (!std::filesystem::exists(properties["output"][0])) {
-    std::filesystem::create_directories(std::filesystem::path(properties["output"][0]).parent_path());
+  // * The LTO backends run in the link, give them the scheduler's jobs. GCC joins our jobserver, ThinLTO gets a count and a cache for unchanged modules
+  if (lto != "off") {
+    const unsigned jobs = jobCount == UINT_MAX ? std::thread::hardware_concurrency() : jobCount;
+    if (!clang) linkerFlags.push_back(jobs == 1 ? "-flto=1" : "-flto=auto");
+    else if (lto == "full") linkerFlags.push_back("-flto");
+    else linkerFlags.push_back("-flto=thin -Wl,-plugin-opt,jobs=" + std::to_string(jobs) + " -Wl,-plugin-opt,cache-dir=" + std::filesystem::absolute(buildDir / "thinlto-cache").string());
+  }
+
+  // * BOLT rewrites a copy linked into the build directory, with relocations so it can move code around
+  const std::string output = properties["output"][0];
+  std::string linked = output;
+  std::vector<size_t> linkDeps = compileJobs;
+  std::vector<std::string> linkInputs(objects.begin(), objects.end());
+  const auto order = buildDir / "layout.order", fdata = buildDir / "layout.fdata";
+  if (!layoutProfile.empty() && !lastModified(layoutProfile)) error("Layout profile '%s' not found!\n", layoutProfile.c_str());
+  if (bolt) {
+    linked = (buildDir / getFilename(output)).generic_string();
+    linkerFlags.push_back("-Wl,--emit-relocs");
+  } else if (!layoutProfile.empty()) {
+    // * gold orders sections, GCC puts each function in .text.<name> or a hot, unlikely or startup variant of it
+    if (lastModified(order) <= lastModified(layoutProfile)) {
+      const std::string symbols = hasExtension(layoutProfile, ".txt") ? "cat " + layoutProfile : "perf report -i " + layoutProfile + " --no-children --no-demangle --sort symbol --stdio --quiet | awk '/\\[\\.\\]/ {print $NF}'";
+      const std::string reason = lastModified(order) ? newer(layoutProfile, order) : "'" + order.generic_string() + "' missing";
+      linkDeps.push_back(addJob(symbols + " | awk '{print \".text.\" $1; print \".text.hot.\" $1; print \".text.unlikely.\" $1; print \".text.startup.\" $1}' > " + order.generic_string(), order.string(), reason));
+      if (!relink) relinkReason = "'" + order.generic_string() + "' regenerated";
+      relink = true;
+    }
+    linkInputs.push_back(std::filesystem::absolute(order).string());
+    // * With LTO the sections are only made in the link
+    linkerFlags.push_back("-ffunction-sections -fuse-ld=gold -Wl,--section-ordering-file=" + std::filesystem::absolute(order).string());
+  }
+
+  if (!lastModified(linked)) {
+    if (!dryRun) std::filesystem::create_directories(std::filesystem::path(linked).parent_path());
+    relinkReason = "'" + linked + "' missing";
+    relink = true;
+  }
+  std::string linkCommand = "@" + cxxCompiler + " ";
+  {
+    PhaseTimer timer(Phase::Commands);
+    for (const auto& object : objects) linkCommand += object + ' ';
+    linkCommand += "-o " + linked + ' ';
+    for (const auto& flag : linkerFlags) linkCommand += flag + ' ';
+  }
+  if (!relink && commandChanged(linked, linkCommand)) {
+    relinkReason = "command changed";
     relink = true;
   }
+  size_t outputJob = SIZE_MAX;
   if (relink) {
-    std::string command = "@" + cxxCompiler + " ";
-    std::replace(command.begin(), command.end(), 'c', '+');
+    outputJob = addJob(linkCommand, linked, relinkReason, JobKind::Link, linkDeps);
+    if (!rebuild) restatJob(outputJob, linkInputs);
+  }
 
-    for (const auto& object : objects) command += object + ' ';
-    command += "-o " + properties["output"][0] + ' ';
+  // * Only rerun BOLT when the linked binary or the profile changed
+  if (bolt && (outputJob != SIZE_MAX || !lastModified(output) || lastModified(output) <= lastModified(layoutProfile))) {
+    const std::string reason = outputJob != SIZE_MAX ? "'" + linked + "' relinked" : !lastModified(output) ? "'" + output + "' missing" : newer(layoutProfile, output);
+    std::vector<size_t> deps;
+    if (outputJob != SIZE_MAX) deps.push_back(outputJob);
+    std::string data = layoutProfile;
+    if (!hasExtension(layoutProfile, ".fdata")) {
+      data = fdata.generic_string();
+      deps = {addJob("perf2bolt -p " + layoutProfile + " -o " + data + ' ' + linked, fdata.string(), reason, JobKind::Link, deps)};
+      if (!rebuild) restatJob(deps[0], {std::filesystem::absolute(linked).string(), std::filesystem::absolute(layoutProfile).string()});
+    }
+    outputJob = addJob("llvm-bolt " + linked + " -o " + output + " -data=" + data + " -reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold", output, reason, JobKind::Link, deps);
+    if (!rebuild) restatJob(outputJob, {std::filesystem::absolute(linked).string(), std::filesystem::absolute(data).string()});
+  }
 
-    for (const auto& flag : linkerFlags) command += flag + ' ';
-    if (!execute(command)) exit(-1);
+  // * The package only waits for the output, so it overlaps with the rest of the build
+  const std::string package = output + ".dwp";
+  size_t packageJob = SIZE_MAX;
+  if (debugPackage && (outputJob != SIZE_MAX || !lastModified(package))) {
+    // * binutils dwp can't read the DWARF 5 that newer compilers emit by default, prefer the LLVM one
+    const std::string command = (toolAvailable("llvm-dwp") ? "llvm-dwp" : "dwp") + std::string(" -e ") + output + " -o " + package;
+    if (outputJob != SIZE_MAX) packageJob = addJob(command, package, "'" + output + "' relinked", JobKind::Link, {outputJob});
+    else packageJob = addJob(command, package, "'" + package + "' missing", JobKind::Link);
   }
+  if (packageJob != SIZE_MAX && !rebuild) restatJob(packageJob, {std::filesystem::absolute(output).string()});
+
+  // * The products go into the build stamp, so run notices them missing or replaced
+  lastModified(output);
+  if (debugPackage) lastModified(package);
 
   std::filesystem::current_path(originalPath);
   return properties["output"];
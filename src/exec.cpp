@@ -1,4 +1,7 @@
 #include "00Names.hpp"
+#include <memory>
+#include <set>
+#include <fstream>
 
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
 #include <windows.h>
@@ -6,12 +9,136 @@
 #include <unistd.h>
 #endif
 
+// * Nothing is written while jobs are being planned, so stats are cached until the jobs run
+static std::unordered_map<std::string, uint64_t> modified;
+// * Everything ever stated, the build stamp covers these
+static std::set<std::string> inputs;
+
+uint64_t lastModified(const std::filesystem::path& filename) {
+  const auto path = std::filesystem::absolute(filename).string();
+  const auto cached = modified.find(path);
+  if (cached != modified.end()) return cached->second;
+  PhaseTimer timer(Phase::Stat);
+  count(Counter::Stats);
+  inputs.insert(path);
+  return modified[path] = statModified(path);
+}
+
+// * Stats the files that aren't cached yet in one batch, before they're asked for one by one
+void prefetchModified(const std::vector<std::string>& filenames) {
+  std::vector<std::string> paths;
+  for (const auto& filename : filenames) {
+    auto path = std::filesystem::absolute(filename).string();
+    if (!modified.count(path)) paths.push_back(std::move(path));
+  }
+  if (paths.empty()) return;
+  PhaseTimer timer(Phase::Stat);
+  count(Counter::Stats, paths.size());
+  const auto times = statModified(paths);
+  for (size_t i = 0; i < paths.size(); i++) {
+    inputs.insert(paths[i]);
+    modified[paths[i]] = times[i];
+  }
+}
+
+void forgetModified() { modified.clear(); }
+
+/*          STAMP          */
+// Format: the key, the output, then "<modification time>\t<path>" for every buildfile, globbed directory and file the build looked at.
+// If none of them changed, planning again would find nothing to do.
+void writeStamp(const std::filesystem::path& stampFile, const std::string& key, const std::string& output) {
+  // * Create the stamp before stating, so its own directory entry doesn't invalidate it
+  std::ofstream(stampFile, std::ios::app);
+  forgetModified();
+  std::string stamp = key + '\n' + std::filesystem::absolute(output).string() + '\n';
+  prefetchModified(std::vector<std::string>(inputs.begin(), inputs.end()));
+  for (const auto& path : inputs) stamp += std::to_string(lastModified(path)) + '\t' + path + '\n';
+  std::ofstream(stampFile) << stamp;
+}
+
+std::string freshStamp(const std::filesystem::path& stampFile, const std::string& key) {
+  std::ifstream file(stampFile);
+  std::string line, output;
+  if (!std::getline(file, line) || line != key || !std::getline(file, output)) return "";
+  std::vector<std::string> paths, times;
+  while (std::getline(file, line)) {
+    const size_t tab = line.find('\t');
+    if (tab == std::string::npos) return "";
+    times.push_back(line.substr(0, tab));
+    paths.push_back(line.substr(tab + 1));
+  }
+  const auto current = statModified(paths);
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (std::to_string(current[i]) != times[i]) return "";
+  }
+  return output;
+}
+
 bool execute(std::string command) {
   if (command[0] == '@') command.erase(command.begin());
   else puts(command.c_str());
+  fflush(stdout);
+  count(Counter::Processes);
   return system(command.c_str()) == 0;
 }
 
+// * Replaces OreBuild with the program, no shell in between
+int runProgram(const std::filesystem::path& program, const std::vector<std::string>& arguments) {
+  fflush(stdout);
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+  std::string command = '"' + program.string() + '"';
+  for (const auto& argument : arguments) command += " \"" + argument + '"';
+  return system(command.c_str());
+#else
+  std::vector<char*> argv = {const_cast<char*>(program.c_str())};
+  for (const auto& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+  argv.push_back(nullptr);
+  execv(program.c_str(), argv.data());
+  error("Failed to run '%s'!\n", program.c_str());
+  return -1;
+#endif
+}
+
+std::string executeWOut(const std::string& command) {
+  count(Counter::Processes);
+  std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
+  if (!pipe) error("Failed to execute '%s'!\n", command.c_str());
+  std::string result;
+  char buffer[1024];
+  while (fgets(buffer, sizeof(buffer), pipe.get()) != nullptr) {
+    result += buffer;
+  }
+  return result;
+}
+
+// * 64-bit FNV-1a, as hex
+static void fnv(uint64_t& hash, const char* data, size_t size) {
+  for (size_t i = 0; i < size; i++) hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3;
+}
+
+static std::string hex(uint64_t hash) {
+  char buffer[17];
+  snprintf(buffer, sizeof(buffer), "%016lx", hash);
+  return buffer;
+}
+
+std::string hashData(const std::string& data) {
+  uint64_t hash = 0xcbf29ce484222325;
+  fnv(hash, data.data(), data.size());
+  return hex(hash);
+}
+
+std::string hashFile(const std::filesystem::path& path) {
+  FILE* file = fopen(path.string().c_str(), "rb");
+  if (!file) return "";
+  uint64_t hash = 0xcbf29ce484222325;
+  char buffer[65536];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) fnv(hash, buffer, size);
+  fclose(file);
+  return hex(hash);
+}
+
 std::filesystem::path getProgramPath() {
   char buffer[1024];
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
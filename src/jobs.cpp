@@ -0,0 +1,473 @@
+#include "00Names.hpp"
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <cerrno>
+#include <chrono>
+#include <queue>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define JOBS_SERIAL
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
+
+unsigned jobCount = 0;
+
+/*          JOBSERVER          */
+// GNU make jobserver: every process owns one implicit token, each additional parallel job needs a token read from the shared pipe/fifo
+#ifndef JOBS_SERIAL
+static int jobserverRead = -1, jobserverWrite = -1;
+static std::string tokens;
+
+static bool validFd(int fd) { return fd >= 0 && fcntl(fd, F_GETFD) != -1; }
+
+static bool connectJobserver(const std::string& makeflags) {
+  std::string auth;
+  for (const std::string key : {"--jobserver-auth=", "--jobserver-fds="}) {
+    const size_t start = makeflags.rfind(key);
+    if (start == std::string::npos) continue;
+    auth = makeflags.substr(start + key.size());
+    auth = auth.substr(0, auth.find(' '));
+    break;
+  }
+  if (auth.empty()) return false;
+
+  if (auth.substr(0, 5) == "fifo:") {
+    jobserverRead = open(auth.substr(5).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    jobserverWrite = open(auth.substr(5).c_str(), O_WRONLY | O_CLOEXEC);
+  } else {
+    int read = -1, write = -1;
+    if (sscanf(auth.c_str(), "%d,%d", &read, &write) != 2 || !validFd(read) || !validFd(write)) {
+      puts("Warning: jobserver unavailable, make sure OreBuild is invoked as a recursive make command (prefix it with '+')!");
+      return false;
+    }
+    // * Reopen the pipe to get a nonblocking file description of our own, make's one must stay blocking
+    jobserverRead = open(("/proc/self/fd/" + std::to_string(read)).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (jobserverRead == -1) jobserverRead = read;
+    jobserverWrite = write;
+  }
+  return validFd(jobserverRead) && validFd(jobserverWrite);
+}
+
+static bool acquireToken() {
+  char token;
+  if (read(jobserverRead, &token, 1) != 1) return false;
+  tokens += token;
+  return true;
+}
+
+static void releaseToken() {
+  if (tokens.empty()) return;
+  while (write(jobserverWrite, &tokens.back(), 1) == -1 && errno == EINTR) continue;
+  tokens.pop_back();
+}
+#endif
+
+/*          HISTORY          */
+// Per-output records of previous runs, kept in the project's build directory
+struct JobRecord {
+  uint64_t peakMemory = 0; // KiB
+  uint64_t duration = 0;   // ms
+  std::string command;     // hash
+  std::string hash;        // of the output's content, valid while its mtime is 'modified'
+  uint64_t modified = 0;
+  std::string inputs;      // hash of the input hashes the output was last built from
+};
+
+static std::filesystem::path historyPath;
+static std::unordered_map<std::string, JobRecord> history;
+
+static void loadHistory(const std::filesystem::path& path) {
+  historyPath = path;
+  FILE* file = fopen(path.string().c_str(), "r");
+  if (!file) return;
+  char line[4096];
+  while (fgets(line, sizeof(line), file)) {
+    std::vector<std::string> fields(1);
+    for (const char* c = line; *c && *c != '\n'; c++) {
+      if (*c == '\t') fields.emplace_back();
+      else fields.back() += *c;
+    }
+    if (fields.size() < 2) continue;
+    fields.resize(7);
+    for (auto& field : fields) {
+      if (field == "-") field.clear();
+    }
+
+    JobRecord& record = history[fields[0]];
+    record.peakMemory = strtoull(fields[1].c_str(), nullptr, 10);
+    record.duration = strtoull(fields[2].c_str(), nullptr, 10);
+    record.command = fields[3];
+    record.hash = fields[4];
+    record.modified = strtoull(fields[5].c_str(), nullptr, 10);
+    record.inputs = fields[6];
+  }
+  fclose(file);
+}
+
+static void saveHistory() {
+  if (historyPath.empty()) return;
+  std::filesystem::create_directories(historyPath.parent_path());
+  FILE* file = fopen(historyPath.string().c_str(), "w");
+  if (!file) return;
+  const auto field = [](const std::string& value) { return value.empty() ? "-" : value.c_str(); };
+  for (const auto& [output, record] : history) {
+    fprintf(file, "%s\t%lu\t%lu\t%s\t%s\t%lu\t%s\n", output.c_str(), record.peakMemory, record.duration, field(record.command), field(record.hash), record.modified, field(record.inputs));
+  }
+  fclose(file);
+}
+
+void initJobs(const std::filesystem::path& historyFile) {
+  loadHistory(historyFile);
+#ifndef JOBS_SERIAL
+  const char* makeflags = getenv("MAKEFLAGS");
+  if (makeflags && connectJobserver(makeflags)) {
+    if (!jobCount) jobCount = -1;
+    return;
+  }
+#endif
+  if (!jobCount) jobCount = std::max(std::thread::hardware_concurrency(), 1u);
+#ifndef JOBS_SERIAL
+  if (jobCount == 1) return;
+
+  // * Serve our own jobserver, so compilers and nested builds share the same slots
+  int fds[2];
+  if (pipe(fds) == -1) return;
+  jobserverRead = fds[0];
+  jobserverWrite = fds[1];
+  const std::string slots(jobCount - 1, '+');
+  if (write(jobserverWrite, slots.data(), slots.size()) != (ssize_t)slots.size()) error("Failed to fill jobserver pipe!\n");
+  const std::string auth = std::to_string(jobserverRead) + ',' + std::to_string(jobserverWrite);
+  setenv("MAKEFLAGS", (" -j" + std::to_string(jobCount) + " --jobserver-auth=" + auth + " --jobserver-fds=" + auth).c_str(), true);
+
+  // * Use a private nonblocking description for our reads
+  const int read = open(("/proc/self/fd/" + std::to_string(jobserverRead)).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (read != -1) jobserverRead = read;
+  else fcntl(jobserverRead, F_SETFL, O_NONBLOCK);
+#endif
+}
+
+/*          SCHEDULER          */
+struct Job {
+  std::string command, output, reason;
+  std::filesystem::path directory;
+  JobKind kind;
+  std::vector<size_t> deps;
+  RemoteAction remote;
+  std::vector<std::string> inputs; // only for restat jobs
+  uint64_t size = 0;               // bytes the job reads, when known
+};
+
+unsigned linkJobCount = 1;
+bool explain = false, dryRun = false;
+double maxLoad = 0;
+uint64_t maxMemory = 0;
+static std::vector<Job> queue;
+static std::unordered_map<std::string, size_t> queued;
+
+uint64_t parseSize(const std::string& size) {
+  char* end;
+  const double value = strtod(size.c_str(), &end);
+  switch (toupper(*end)) {
+  case 'K': return value * 1024;
+  case 'G': return value * 1024 * 1024 * 1024;
+  case 'T': return value * 1024 * 1024 * 1024 * 1024;
+  default: return value * 1024 * 1024;
+  }
+}
+
+// * A module planned twice, like a library shared by two dependencies, gets its jobs once
+size_t addJob(const std::string& command, const std::string& output, const std::string& reason, JobKind kind, const std::vector<size_t>& deps) {
+  const auto path = std::filesystem::absolute(output).lexically_normal().string();
+  if (queued.count(path)) return queued[path];
+  count(Counter::CommandBytes, command.size());
+  queue.push_back(Job{command, path, reason, std::filesystem::current_path(), kind, deps});
+  return queued[path] = queue.size() - 1;
+}
+
+// * Only a recorded command can change, outputs without history are built for other reasons
+bool commandChanged(const std::string& output, const std::string& command) {
+  const auto path = std::filesystem::absolute(output).lexically_normal().string();
+  return history.count(path) && !history[path].command.empty() && history[path].command != hashData(command);
+}
+
+// * Ninja-style restat: the job is skipped when its command and the content of its inputs are the same as when the output was last built
+void restatJob(size_t job, const std::vector<std::string>& inputs) { queue[job].inputs = inputs; }
+
+// * Jobs that were never run are estimated from their size relative to other jobs
+void sizeJob(size_t job, uint64_t bytes) { queue[job].size = bytes; }
+
+// * The planned jobs of a kind, for tools that want the commands rather than their outputs
+std::vector<PlannedJob> plannedJobs(JobKind kind) {
+  std::vector<PlannedJob> jobs;
+  for (const auto& job : queue) {
+    if (job.kind == kind) jobs.push_back(PlannedJob{job.command, job.output, job.directory});
+  }
+  return jobs;
+}
+
+// * Milliseconds the last run of the job producing the output took, 0 if unknown
+uint64_t recordedDuration(const std::string& output) {
+  const auto path = std::filesystem::absolute(output).lexically_normal().string();
+  return history.count(path) ? history[path].duration : 0;
+}
+
+// * Content hash of a file, only read again when its mtime changes
+static std::string contentHash(const std::string& path) {
+  std::error_code error;
+  const uint64_t modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+  if (error) return "";
+  JobRecord& record = history[path];
+  if (record.hash.empty() || record.modified != modified) {
+    record.hash = hashFile(path);
+    record.modified = modified;
+  }
+  return record.hash;
+}
+
+static std::string inputsHash(const Job& job) {
+  if (job.inputs.empty()) return "";
+  // * The command is part of it, a link with other flags isn't the same output
+  std::string hashes = hashData(job.command) + '\n';
+  for (const auto& input : job.inputs) hashes += input + ' ' + contentHash(input) + '\n';
+  return hashData(hashes);
+}
+
+static bool upToDate(const Job& job, const std::string& inputs) {
+  if (inputs.empty() || history[job.output].inputs != inputs || !std::filesystem::exists(job.output)) return false;
+  if (explain) printf("explain: %s: inputs unchanged, skipped\n", std::filesystem::path(job.output).lexically_proximate(std::filesystem::current_path()).generic_string().c_str());
+  return true;
+}
+
+static void explainJob(const Job& job) {
+  if (!explain) return;
+  const auto output = std::filesystem::path(job.output).lexically_proximate(std::filesystem::current_path());
+  printf("explain: %s: %s\n", output.generic_string().c_str(), job.reason.c_str());
+}
+
+static bool finishJobs(bool success) {
+  for (const auto& job : queue) {
+    if (job.kind == JobKind::Scratch) history.erase(job.output);
+  }
+  queue.clear();
+  queued.clear();
+  saveHistory();
+  forgetModified();
+  return success;
+}
+
+void discardJobs() { finishJobs(true); }
+
+void offloadJob(size_t job, const RemoteAction& action) {
+  queue[job].remote = action;
+  queue[job].remote.output = std::filesystem::absolute(action.output).string();
+}
+
+#ifndef JOBS_SERIAL
+// * Totals of a recorded value over the queued jobs of a kind, gathered once per run rather than for every estimate
+struct Averages {
+  uint64_t total = 0, count = 0, sizedTotal = 0, sizedBytes = 0, bytes = 0, sized = 0;
+};
+
+static std::vector<Averages> averages(uint64_t JobRecord::*field) {
+  std::vector<Averages> result(4);
+  for (const auto& job : queue) {
+    Averages& kind = result[(size_t)job.kind];
+    kind.bytes += job.size;
+    kind.sized += job.size != 0;
+    const auto record = history.find(job.output);
+    if (record == history.end() || !(record->second.*field)) continue;
+    kind.total += record->second.*field;
+    kind.count++;
+    if (job.size) {
+      kind.sizedTotal += record->second.*field;
+      kind.sizedBytes += job.size;
+    }
+  }
+  return result;
+}
+
+// * A recorded value for the job, or the average of queued jobs of the same kind, or the fallback.
+// Sized jobs scale the average by their size, a source pulling in twice the headers takes about twice as long
+static uint64_t estimate(const Job& job, uint64_t JobRecord::*field, const std::vector<Averages>& averages, uint64_t fallback) {
+  const auto record = history.find(job.output);
+  if (record != history.end() && record->second.*field) return record->second.*field;
+  const Averages& kind = averages[(size_t)job.kind];
+  if (job.size && kind.sizedBytes) return std::max<uint64_t>(1, double(kind.sizedTotal) / kind.sizedBytes * job.size);
+  if (kind.count) return kind.total / kind.count;
+  return job.size ? std::max<uint64_t>(1, double(fallback) * job.size / (kind.bytes / kind.sized)) : fallback;
+}
+
+static uint64_t availableMemory() {
+  FILE* file = fopen("/proc/meminfo", "r");
+  if (!file) return -1;
+  char line[256];
+  uint64_t available = -1;
+  while (fgets(line, sizeof(line), file)) {
+    if (sscanf(line, "MemAvailable: %lu kB", &available) == 1) break;
+  }
+  fclose(file);
+  return available;
+}
+
+static bool overloaded() {
+  double load;
+  return maxLoad > 0 && getloadavg(&load, 1) == 1 && load >= maxLoad;
+}
+
+static uint64_t now() { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+#endif
+
+bool runJobs() {
+  if (dryRun) {
+    for (const auto& job : queue) {
+      explainJob(job);
+      puts(job.command.c_str() + (job.command[0] == '@'));
+    }
+    return finishJobs(true);
+  }
+
+#ifdef JOBS_SERIAL
+  const auto originalPath = std::filesystem::current_path();
+  for (const auto& job : queue) {
+    const std::string inputs = inputsHash(job);
+    if (upToDate(job, inputs)) continue;
+    explainJob(job);
+    std::filesystem::current_path(job.directory);
+    PhaseTimer timer(job.kind == JobKind::Link ? Phase::Link : Phase::Compile);
+    const bool success = execute(job.command);
+    std::filesystem::current_path(originalPath);
+    if (!success) return finishJobs(false);
+    history[job.output].command = hashData(job.command);
+    history[job.output].inputs = inputs;
+  }
+  return finishJobs(true);
+#else
+  // * Critical path: a job's priority is the longest chain of expected durations from it to the end of the build
+  std::vector<std::vector<size_t>> dependents(queue.size());
+  std::vector<size_t> waiting(queue.size());
+  for (size_t i = 0; i < queue.size(); i++) {
+    waiting[i] = queue[i].deps.size();
+    for (const auto dep : queue[i].deps) dependents[dep].push_back(i);
+  }
+  const std::vector<Averages> durations = averages(&JobRecord::duration), memories = averages(&JobRecord::peakMemory);
+  std::vector<uint64_t> priority(queue.size());
+  for (size_t i = queue.size(); i-- > 0;) {
+    uint64_t tail = 0;
+    for (const auto dependent : dependents[i]) tail = std::max(tail, priority[dependent]);
+    priority[i] = estimate(queue[i], &JobRecord::duration, durations, 1000) + tail;
+  }
+
+  // * The most critical ready job is on top
+  std::priority_queue<std::pair<uint64_t, size_t>> ready;
+  const auto makeReady = [&](size_t job) { ready.emplace(priority[job], job); };
+  for (size_t i = 0; i < queue.size(); i++) {
+    if (!waiting[i]) makeReady(i);
+  }
+
+  struct Running {
+    size_t job;
+    uint64_t memory, start;
+    std::string inputs;
+  };
+  std::unordered_map<pid_t, Running> running;
+  const uint64_t memoryBudget = maxMemory ? maxMemory / 1024 : availableMemory();
+  uint64_t memoryReserved = 0;
+  unsigned links = 0;
+  size_t remoteIndex = 0;
+  bool failed = false;
+  while ((!ready.empty() && !failed) || !running.empty()) {
+    // * Start the most critical jobs as slots, tokens, memory and load allow, the first job always starts
+    bool throttled = false;
+    std::vector<size_t> waitingLinks; // links without a free link slot, back in the queue once this round is over
+    while (!ready.empty() && !failed && running.size() < jobCount) {
+      const size_t next = ready.top().second;
+      if (queue[next].kind == JobKind::Link && links >= linkJobCount) {
+        ready.pop();
+        waitingLinks.push_back(next);
+        continue;
+      }
+      const Job& job = queue[next];
+      const std::string inputs = inputsHash(job);
+      if (upToDate(job, inputs)) {
+        ready.pop();
+        for (const auto dependent : dependents[next]) {
+          if (!--waiting[dependent]) makeReady(dependent);
+        }
+        continue;
+      }
+      const uint64_t memory = estimate(job, &JobRecord::peakMemory, memories, job.kind == JobKind::Link ? 2 * 1024 * 1024 : job.kind == JobKind::Fetch ? 256 * 1024 : 1024 * 1024);
+      if (!running.empty() && (memoryReserved + memory > memoryBudget || overloaded())) {
+        throttled = true;
+        break;
+      }
+      if (!running.empty() && jobserverRead != -1 && !acquireToken()) break;
+
+      explainJob(job);
+      std::string command = job.command, worker;
+      if (!job.remote.preprocess.empty() && !remoteWorkers.empty()) worker = remoteWorkers[remoteIndex++ % remoteWorkers.size()];
+      if (command[0] == '@') command.erase(command.begin());
+      else if (!worker.empty()) printf("[%s] %s\n", worker.c_str(), command.c_str());
+      else puts(command.c_str());
+      fflush(stdout);
+
+      const pid_t pid = fork();
+      if (pid == -1) error("Failed to start '%s'!\n", command.c_str());
+      count(Counter::Processes);
+      if (pid == 0) {
+        if (chdir(job.directory.c_str()) == -1) _exit(127);
+        if (!worker.empty()) {
+          const int code = remoteCompile(job.remote, worker);
+          if (code >= 0) _exit(code);
+          fprintf(stderr, "Warning: worker %s unavailable, compiling locally!\n", worker.c_str());
+        }
+        execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+        _exit(127);
+      }
+      running[pid] = Running{next, memory, now(), inputs};
+      memoryReserved += memory;
+      if (job.kind == JobKind::Link) links++;
+      ready.pop();
+    }
+    for (const auto link : waitingLinks) makeReady(link);
+
+    // * Wait for a job to finish, a token to become available or the load to drop
+    const bool wantToken = jobserverRead != -1 && !ready.empty() && !failed && running.size() < jobCount;
+    int status;
+    rusage usage;
+    pid_t pid;
+    PhaseTimer timer(links ? Phase::Link : Phase::Compile);
+    if (wantToken || throttled) {
+      pollfd fd = {jobserverRead, POLLIN, 0};
+      poll(&fd, wantToken, throttled ? 250 : 50);
+      pid = wait4(-1, &status, WNOHANG, &usage);
+    } else pid = wait4(-1, &status, 0, &usage);
+    if (pid <= 0 || !running.count(pid)) continue;
+
+    const Running finished = running[pid];
+    const Job& job = queue[finished.job];
+    memoryReserved -= finished.memory;
+    if (job.kind == JobKind::Link) links--;
+    running.erase(pid);
+    while (tokens.size() + 1 > std::max<size_t>(running.size(), 1)) releaseToken();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed = true;
+      continue;
+    }
+
+    history[job.output].peakMemory = usage.ru_maxrss;
+    history[job.output].duration = std::max<uint64_t>(now() - finished.start, 1);
+    history[job.output].command = hashData(job.command);
+    history[job.output].inputs = finished.inputs;
+    for (const auto dependent : dependents[finished.job]) {
+      if (!--waiting[dependent]) makeReady(dependent);
+    }
+  }
+  return finishJobs(!failed);
+#endif
+}
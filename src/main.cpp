@@ -2,6 +2,10 @@
 #include "clipp.h"
 
 #include <iostream>
+#include <sstream>
+#include <map>
+
+using namespace std::literals;
 
 // Windows: g++ -std=c++17 -Ofast src\*.cpp -o bin\OreBuild.exe -static
 // Linux: g++ -std=c++17 -Ofast src/*.cpp -o bin/OreBuild
@@ -10,6 +14,15 @@ std::filesystem::path libdirPath;
 std::string platform, configuration;
 
 int main(int argc, char** argv) {
+  // * Everything after -- goes to the program, for run
+  std::vector<std::string> arguments;
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] != "--"s) continue;
+    arguments.assign(argv + i + 1, argv + argc);
+    argc = i;
+    break;
+  }
+
   libdirPath = std::filesystem::absolute(getProgramPath().parent_path() / "libraries");
 
   configuration = "Debug";
@@ -27,47 +40,190 @@ int main(int argc, char** argv) {
     Run,
     Search,
     Install,
+    Worker,
+    Pack,
+    Unpack,
+    Clean,
+    Pgo,
+    Analyze,
     Help,
   } mode = Mode::Help;
 
   // clang-format off
   auto buildMode = (
-    command("build").set(mode, Mode::Build) | command("rebuild").set(mode, Mode::Rebuild) | command("run").set(mode, Mode::Run),
-    (option("-c", "--conf") & value("configuration", configuration)) % "Set the configuration, example Debug or Linux:Debugs"
+    command("build").set(mode, Mode::Build) | command("rebuild").set(mode, Mode::Rebuild) | (command("run").set(mode, Mode::Run) % "Build, then run the output with the arguments after --") |
+      (command("pgo").set(mode, Mode::Pgo) % "Build instrumented, run the train command of the buildfile, then build with the profile"),
+    (option("-c", "--conf") & value("configuration", configuration)) % "Set the configurations, example Debug or Debug,Release,Linux:Profile",
+    (option("-j", "--jobs") & value("jobs", jobCount)) % "Maximum number of parallel jobs, defaults to the number of cores or the make jobserver",
+    (option("--link-jobs") & value("jobs", linkJobCount)) % "Maximum number of parallel link jobs, default 1",
+    (option("--max-load") & value("load", maxLoad)) % "Don't start new jobs while the load average is above this",
+    (option("--max-mem") & value("size").call([](const char* size) { maxMemory = parseSize(size); })) % "Memory budget for parallel jobs, example 16G, defaults to the available memory",
+    (option("--remote") & values("worker", remoteWorkers)) % "Compile on workers, example localhost:7325 build2:7325",
+    option("--explain").set(explain) % "Print why each action runs",
+    (option("-n", "--dry-run").set(dryRun)) % "Print the actions that would run without running them",
+    option("--stats").set(showStats) % "Print time spent in each phase of OreBuild and internal counters"
   );
 
   std::string package;
+  std::vector<std::string> languages = {"C", "C++"};
+  std::string license, dump;
+  bool offline = false;
+  double ttl = 24;
   auto searchMode = (
     command("search").set(mode, Mode::Search),
-    value("query", package)
+    opt_value("query", package),
+    (option("--language").call([&] { languages.clear(); }) & values("languages").call([&](const char* language) { if (language != "any"s) languages.push_back(language); })) % "Languages to show, default C C++, any for all",
+    (option("--license") & value("license", license)) % "Only show packages with this license, example mit",
+    option("--offline").set(offline) % "Only search the local package index",
+    (option("--ttl") & value("hours", ttl)) % "Refetch queries older than this, default 24",
+    (option("--import") & value("dump", dump)) % "Add packages from 'gh search repos --json fullName,language,license,description' output to the local index"
   );
 
+  std::vector<std::string> packages;
+  bool update = false;
+  std::string mirror = getenv("OREBUILD_MIRROR") ? getenv("OREBUILD_MIRROR") : "https://github.com";
   auto installMode = (
     command("install").set(mode, Mode::Install),
-    value("github package ID", package)
+    opt_values("github package IDs", packages) % "Packages to install, defaults to everything in orebuild.lock",
+    option("-u", "--update").set(update) % "Fetch the latest commit instead of the one pinned in orebuild.lock",
+    (option("-j", "--jobs") & value("jobs", jobCount)) % "Maximum number of parallel downloads",
+    (option("--mirror") & value("url", mirror)) % "Fetch from this URL prefix instead of https://github.com, also set by OREBUILD_MIRROR"
+  );
+
+  std::string address = "127.0.0.1:7325";
+  std::filesystem::path workerCache = std::filesystem::temp_directory_path() / "orebuild-worker";
+  auto workerMode = (
+    command("worker").set(mode, Mode::Worker),
+    (option("--listen") & value("address", address)) % "Address to accept coordinators on, default 127.0.0.1:7325. Workers run any command they get, only listen on trusted networks",
+    (option("--cache") & value("directory").call([&](const char* directory) { workerCache = directory; })) % "Directory for received inputs"
+  );
+
+  std::string archive;
+  auto packMode = (
+    command("pack").set(mode, Mode::Pack),
+    value("library", package),
+    (option("-c", "--conf") & value("configuration", configuration)) % "Configuration of the variants to pack",
+    (option("-o", "--output") & value("archive", archive)) % "Archive to write, default <library>-<platform>-<configuration>.tar.gz"
+  );
+
+  auto unpackMode = (
+    command("unpack").set(mode, Mode::Unpack),
+    value("archive", archive)
+  );
+
+  bool stale = false;
+  auto cleanMode = (
+    command("clean").set(mode, Mode::Clean),
+    option("--stale").set(stale) % "Only remove outputs the buildfiles no longer produce, in the project and its libraries",
+    (option("-c", "--conf") & value("configuration", configuration)) % "Configurations to clean"
+  );
+
+  size_t top = 20;
+  auto analyzeMode = (
+    command("analyze").set(mode, Mode::Analyze),
+    command("includes") % "Rank the headers by how much build time they cost",
+    (option("-c", "--conf") & value("configuration", configuration)) % "Configuration to analyze",
+    (option("-j", "--jobs") & value("jobs", jobCount)) % "Maximum number of parallel preprocessors",
+    (option("--top") & value("count", top)) % "Number of headers to show, default 20"
   );
 
   auto cli = (
-    (buildMode | searchMode | installMode | command("help").set(mode, Mode::Help)),
+    (buildMode | searchMode | installMode | workerMode | packMode | unpackMode | cleanMode | analyzeMode | command("help").set(mode, Mode::Help)),
     option("-v", "--version").call([] {puts("Version 3.0\n");}).doc("Show version")
   );
   // clang-format on
 
   if (parse(argc, argv, cli)) {
+    // * Configurations are 'configuration' or 'platform:configuration', separated by commas
+    std::vector<std::pair<std::string, std::string>> configurations;
+    std::stringstream list(configuration);
+    for (std::string item; std::getline(list, item, ',');) {
+      const auto colon = item.find(':');
+      if (colon == std::string::npos) configurations.emplace_back(platform, item);
+      else configurations.emplace_back(item.substr(0, colon), item.substr(colon + 1));
+    }
+    if (configurations.empty()) error("No configuration specified!\n");
+    std::tie(platform, configuration) = configurations[0];
+
     if (mode == Mode::Help) std::cout << make_man_page(cli, "OreBuild");
-    else if (mode == Mode::Search) searchPackage(package);
-    else if (mode == Mode::Install) installPackage(package);
+    else if (mode == Mode::Search) {
+      if (!dump.empty()) importPackages(dump);
+      if (!package.empty()) searchPackage(package, languages, license, offline, ttl);
+    }
+    else if (mode == Mode::Install) installPackages(packages, mirror, update);
+    else if (mode == Mode::Worker) runWorker(address, workerCache);
+    else if (mode == Mode::Pack) packLibrary(package, archive);
+    else if (mode == Mode::Unpack) unpackLibrary(archive);
     else {
-      auto colon = configuration.find(':');
-      if (colon != std::string::npos) {
-        platform = configuration.substr(0, colon);
-        configuration = configuration.substr(colon + 1);
+      // * If nothing changed since the last build, skip planning entirely
+      const auto stampFile = std::filesystem::absolute("build") / ".orebuild_stamp";
+      std::string key = libdirPath.string();
+      for (const auto& [targetPlatform, targetConfiguration] : configurations) key += ' ' + targetPlatform + ':' + targetConfiguration;
+      if (mode == Mode::Run && !dryRun && !explain) {
+        const std::string output = freshStamp(stampFile, key);
+        if (!output.empty()) return runProgram(output, arguments);
       }
 
-      bool skip = true;
+      initJobs(std::filesystem::absolute("build") / ".orebuild_log");
       if (mode == Mode::Rebuild) rebuild = true;
-      if (mode == Mode::Build || mode == Mode::Rebuild) buildModule(std::filesystem::absolute("project.orebuild"), skip);
-      else if (mode == Mode::Run) return !execute(buildModule(std::filesystem::absolute("project.orebuild"), skip)[0]) * -1;
+      pruneStale = !dryRun;
+
+      // * Plan every configuration first, so all their jobs share one scheduler
+      const auto plan = [&] {
+        std::vector<std::string> output;
+        std::map<std::filesystem::path, std::string> outputs;
+        for (const auto& [targetPlatform, targetConfiguration] : configurations) {
+          platform = targetPlatform;
+          configuration = targetConfiguration;
+          bool skip = true;
+          const auto built = buildModule(std::filesystem::absolute("project.orebuild"), skip);
+          const auto path = std::filesystem::absolute(built[0]).lexically_normal();
+          if (outputs.count(path)) error("Configurations %s and %s:%s both output '%s'!\n", outputs[path].c_str(), platform.c_str(), configuration.c_str(), built[0].c_str());
+          outputs[path] = platform + ':' + configuration;
+          if (output.empty()) output = built;
+        }
+        return output;
+      };
+
+      if (mode == Mode::Analyze) {
+        // * Plan a full rebuild without running it, for the compile commands
+        dryRun = rebuild = true;
+        pruneStale = false;
+        plan();
+        const auto compiles = plannedJobs(JobKind::Compile);
+        discardJobs();
+        dryRun = rebuild = false;
+        analyzeIncludes(compiles, top);
+        return 0;
+      } else if (mode == Mode::Clean && stale) {
+        dryRun = pruneStale = true;
+        plan();
+        discardJobs();
+        return 0;
+      } else if (mode == Mode::Clean) {
+        for (const auto& [targetPlatform, targetConfiguration] : configurations) {
+          const auto buildDir = std::filesystem::path("build") / targetPlatform / targetConfiguration;
+          printf("Removing '%s'\n", buildDir.generic_string().c_str());
+          std::filesystem::remove_all(buildDir);
+          std::filesystem::remove_all(buildDir.string() + "-instrumented");
+        }
+        return 0;
+      }
+
+      if (mode == Mode::Pgo) {
+        instrument = true;
+        plan();
+        if (!runJobs() || !trainProfiles()) return -1;
+        instrument = false;
+      }
+
+      const auto output = plan();
+      const bool success = runJobs();
+      printStats();
+      if (!success) return -1;
+      if (!dryRun) writeStamp(stampFile, key, output[0]);
+      if (mode == Mode::Run && dryRun) puts(output[0].c_str());
+      else if (mode == Mode::Run) return runProgram(output[0], arguments);
     }
   } else std::cout << usage_lines(cli, "OreBuild") << '\n';
   return 0;
@@ -0,0 +1,168 @@
+#include "00Names.hpp"
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define METADATA_SERIAL
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define METADATA_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+/*          METADATA          */
+// Modification times, in nanoseconds since the epoch, 0 for files that don't exist. Batches keep many stats in flight,
+// through io_uring where the kernel allows it and a pool of threads otherwise, so round trips to network filesystems overlap.
+
+#ifdef METADATA_SERIAL
+uint64_t statModified(const std::string& path) {
+  std::error_code error;
+  const auto time = std::filesystem::last_write_time(path, error);
+  return error ? 0 : time.time_since_epoch().count();
+}
+
+std::vector<uint64_t> statModified(const std::vector<std::string>& paths) {
+  std::vector<uint64_t> times;
+  for (const auto& path : paths) times.push_back(statModified(path));
+  return times;
+}
+#else
+uint64_t statModified(const std::string& path) {
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) return 0;
+  return uint64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+}
+
+#ifdef METADATA_URING
+struct Ring {
+  int fd = -1;
+  unsigned entries = 0;
+  unsigned *sqTail, *sqMask, *sqArray, *cqHead, *cqTail, *cqMask;
+  io_uring_sqe* sqes;
+  io_uring_cqe* cqes;
+};
+
+// * Kernels without io_uring, or sandboxes that forbid it, get no ring and the thread pool instead
+static Ring* openRing() {
+  static Ring ring;
+  static bool tried = false;
+  if (tried) return ring.fd == -1 ? nullptr : &ring;
+  tried = true;
+
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  const int fd = syscall(__NR_io_uring_setup, 256, &params);
+  if (fd < 0) return nullptr;
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    close(fd);
+    return nullptr;
+  }
+  const size_t ringSize = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  char* rings = (char*)mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (rings == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+  void* sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    munmap(rings, ringSize);
+    close(fd);
+    return nullptr;
+  }
+
+  ring.fd = fd;
+  ring.entries = params.sq_entries;
+  ring.sqTail = (unsigned*)(rings + params.sq_off.tail);
+  ring.sqMask = (unsigned*)(rings + params.sq_off.ring_mask);
+  ring.sqArray = (unsigned*)(rings + params.sq_off.array);
+  ring.cqHead = (unsigned*)(rings + params.cq_off.head);
+  ring.cqTail = (unsigned*)(rings + params.cq_off.tail);
+  ring.cqMask = (unsigned*)(rings + params.cq_off.ring_mask);
+  ring.sqes = (io_uring_sqe*)sqes;
+  ring.cqes = (io_uring_cqe*)(rings + params.cq_off.cqes);
+  return &ring;
+}
+
+static void closeRing(Ring* ring) {
+  close(ring->fd);
+  ring->fd = -1;
+}
+
+// * Submits a ring's worth of statx at a time and waits for all of them, false if the kernel doesn't know statx
+static bool uringModified(Ring* ring, const std::vector<std::string>& paths, std::vector<uint64_t>& times) {
+  // * Kept for good, a ring closed after an error may still finish statx into them
+  static std::vector<struct statx> buffers(ring->entries);
+  for (size_t first = 0; first < paths.size(); first += ring->entries) {
+    const unsigned batch = std::min<size_t>(ring->entries, paths.size() - first);
+    unsigned tail = *ring->sqTail;
+    for (unsigned i = 0; i < batch; i++) {
+      const unsigned index = tail & *ring->sqMask;
+      io_uring_sqe& sqe = ring->sqes[index];
+      memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = IORING_OP_STATX;
+      sqe.fd = AT_FDCWD;
+      sqe.addr = (uint64_t)paths[first + i].c_str();
+      sqe.len = STATX_MTIME;
+      sqe.off = (uint64_t)&buffers[i];
+      sqe.user_data = i;
+      ring->sqArray[index] = index;
+      tail++;
+    }
+    __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+
+    unsigned submit = batch, completed = 0;
+    while (completed < batch) {
+      if (syscall(__NR_io_uring_enter, ring->fd, submit, batch - completed, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) return false;
+      submit = 0;
+      unsigned head = *ring->cqHead;
+      const unsigned cqTail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+      for (; head != cqTail; head++, completed++) {
+        const io_uring_cqe& cqe = ring->cqes[head & *ring->cqMask];
+        if (cqe.res == -EINVAL) return false;
+        const auto& time = buffers[cqe.user_data].stx_mtime;
+        times[first + cqe.user_data] = cqe.res < 0 ? 0 : uint64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+      }
+      __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    }
+  }
+  return true;
+}
+#endif
+
+static void poolModified(const std::vector<std::string>& paths, std::vector<uint64_t>& times) {
+  // * Stats wait on the filesystem rather than the CPU, so there are more threads than cores
+  const size_t threadCount = std::min<size_t>(32, paths.size() / 16 + 1);
+  std::atomic<size_t> next(0);
+  const auto work = [&] {
+    for (size_t i; (i = next++) < paths.size();) times[i] = statModified(paths[i]);
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < threadCount; i++) threads.emplace_back(work);
+  work();
+  for (auto& thread : threads) thread.join();
+}
+
+std::vector<uint64_t> statModified(const std::vector<std::string>& paths) {
+  std::vector<uint64_t> times(paths.size(), 0);
+  if (paths.size() < 8) {
+    for (size_t i = 0; i < paths.size(); i++) times[i] = statModified(paths[i]);
+    return times;
+  }
+#ifdef METADATA_URING
+  if (Ring* ring = openRing()) {
+    if (uringModified(ring, paths, times)) return times;
+    closeRing(ring);
+  }
+#endif
+  poolModified(paths, times);
+  return times;
+}
+#endif
@@ -0,0 +1,154 @@
+#include "00Names.hpp"
+#include "json.hpp"
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <map>
+#include <functional>
+
+/*          MODULES          */
+// Sources are scanned for the named modules they provide and import, in P1689 form: from clang-scan-deps or GCC 14+
+// when they're available, otherwise by reading the module declarations. Scans are cached in <object>.ddi until the source changes.
+
+static std::string readSource(const std::string& file) {
+  std::ifstream stream(file, std::ios::binary);
+  std::stringstream contents;
+  contents << stream.rdbuf();
+  return contents.str();
+}
+
+// * Module declarations start a line, so sources without "module" or "import" at the start of one don't need a scan
+static bool mentionsModules(const std::string& source) {
+  static const std::regex declaration(R"((^|\n)[ \t]*(export[ \t]+)?(module|import)[ \t\n])");
+  return std::regex_search(source, declaration);
+}
+
+static std::string stripComments(const std::string& source) {
+  std::string result;
+  for (size_t i = 0; i < source.size(); i++) {
+    if (source.compare(i, 2, "//") == 0) i = std::min(source.find('\n', i), source.size()) - 1;
+    else if (source.compare(i, 2, "/*") == 0) {
+      i = std::min(source.find("*/", i + 2), source.size() - 2) + 1;
+      result += ' ';
+    } else result += source[i];
+  }
+  return result;
+}
+
+// * Good enough for sources that don't hide their module declarations behind macros
+static ModuleScan readDeclarations(const std::string& source) {
+  static const std::regex declaration(R"((^|;|\n)[ \t]*(export[ \t]+)?(module|import)[ \t\n]+([\w.]*(:[\w.]+)?)[ \t\n]*;)");
+  ModuleScan scan;
+  std::string module;
+  const std::string code = stripComments(source);
+  for (std::sregex_iterator i(code.begin(), code.end(), declaration), end; i != end; i++) {
+    const std::string name = (*i)[4];
+    if ((*i)[3] == "module" && !name.empty() && name[0] != ':') {
+      module = name.substr(0, name.find(':'));
+      // * Implementation units, plain "module foo;", don't provide foo but need its interface
+      if ((*i)[2].matched || name.find(':') != std::string::npos) scan.provides = name;
+      else scan.imports.push_back(name);
+    } else if ((*i)[3] == "import" && !name.empty()) scan.imports.push_back(name[0] == ':' ? module + name : name);
+  }
+  return scan;
+}
+
+// * Scans cached by an older OreBuild may have read the declarations differently, they're scanned again
+static const int scanRevision = 2;
+
+static bool currentScan(const std::filesystem::path& ddi) {
+  std::ifstream file(ddi);
+  const auto json = nlohmann::json::parse(file, nullptr, false);
+  return !json.is_discarded() && json.value("orebuild-revision", 0) == scanRevision;
+}
+
+static void markScan(const std::filesystem::path& ddi) {
+  std::ifstream file(ddi);
+  auto json = nlohmann::json::parse(file, nullptr, false);
+  file.close();
+  if (json.is_discarded()) return;
+  json["orebuild-revision"] = scanRevision;
+  std::ofstream(ddi) << json.dump(2) << '\n';
+}
+
+static ModuleScan readP1689(const std::filesystem::path& ddi) {
+  ModuleScan scan;
+  std::ifstream file(ddi);
+  const auto json = nlohmann::json::parse(file, nullptr, false);
+  if (json.is_discarded() || !json.contains("rules") || json["rules"].empty()) return scan;
+  const auto& rule = json["rules"][0];
+  if (rule.contains("provides") && !rule["provides"].empty()) scan.provides = rule["provides"][0]["logical-name"];
+  if (rule.contains("requires")) {
+    for (const auto& required : rule["requires"]) scan.imports.push_back(required["logical-name"]);
+  }
+  return scan;
+}
+
+static void writeP1689(const std::filesystem::path& ddi, const std::string& object, const ModuleScan& scan) {
+  nlohmann::json rule = {{"primary-output", object}};
+  if (!scan.provides.empty()) rule["provides"] = {{{"logical-name", scan.provides}, {"is-interface", true}}};
+  rule["requires"] = nlohmann::json::array();
+  for (const auto& required : scan.imports) rule["requires"].push_back({{"logical-name", required}});
+  std::ofstream(ddi) << nlohmann::json{{"version", 1}, {"revision", 0}, {"orebuild-revision", scanRevision}, {"rules", {rule}}}.dump(2) << '\n';
+}
+
+static bool scannerWorks(const std::string& probe) {
+  static std::map<std::string, bool> works;
+  if (!works.count(probe)) works[probe] = executeWOut(probe + " > /dev/null 2>&1 && echo ok") == "ok\n";
+  return works[probe];
+}
+
+ModuleScan scanModules(const std::string& file, const std::string& compile, const std::filesystem::path& object, bool clang) {
+  const auto ddi = std::filesystem::path(object).replace_extension(".ddi");
+  if (lastModified(ddi) > lastModified(file) && currentScan(ddi)) return readP1689(ddi);
+
+  const std::string source = readSource(file);
+  if (!dryRun) std::filesystem::create_directories(ddi.parent_path());
+  ModuleScan scan;
+  if (mentionsModules(source)) {
+    // * The compiler sees through macros and conditionals, ask it when it can answer
+    const std::string compiler = compile.substr(0, compile.find(' '));
+    if (clang && scannerWorks("clang-scan-deps --version")) {
+      if (dryRun) return readDeclarations(source);
+      if (execute("@clang-scan-deps -format=p1689 -- " + compile + " > " + ddi.string())) {
+        markScan(ddi);
+        return readP1689(ddi);
+      }
+    } else if (!clang && scannerWorks(compiler + " -fmodules-ts -fdeps-format=p1689r5 -fdeps-file=/dev/null -fdeps-target=probe.o -M -MM -MF /dev/null -E -x c++ /dev/null -o /dev/null")) {
+      const std::string command = replace(compile, " -c ", " -E ") + " -fdeps-format=p1689r5 -fdeps-file=" + ddi.string() + " -fdeps-target=" + object.string() + " -M -MM -MF /dev/null";
+      if (dryRun) return readDeclarations(source);
+      if (execute("@" + replace(command, " -o " + object.generic_string(), " -o /dev/null"))) {
+        markScan(ddi);
+        return readP1689(ddi);
+      }
+    }
+    scan = readDeclarations(source);
+  }
+  if (!dryRun) writeP1689(ddi, object.string(), scan);
+  return scan;
+}
+
+// * Importers come after the sources providing their modules. Modules from elsewhere are left to the compiler
+std::vector<size_t> moduleOrder(const std::vector<ModuleScan>& scans) {
+  std::map<std::string, size_t> providers;
+  for (size_t i = 0; i < scans.size(); i++) {
+    if (scans[i].provides.empty()) continue;
+    if (providers.count(scans[i].provides)) error("Module '%s' is provided twice!\n", scans[i].provides.c_str());
+    providers[scans[i].provides] = i;
+  }
+
+  std::vector<size_t> order;
+  std::vector<int> state(scans.size(), 0);
+  const std::function<void(size_t)> visit = [&](size_t i) {
+    if (state[i] == 2) return;
+    if (state[i] == 1) error("Module import cycle through '%s'!\n", scans[i].provides.c_str());
+    state[i] = 1;
+    for (const auto& required : scans[i].imports) {
+      if (providers.count(required)) visit(providers[required]);
+    }
+    state[i] = 2;
+    order.push_back(i);
+  };
+  for (size_t i = 0; i < scans.size(); i++) visit(i);
+  return order;
+}
@@ -1,31 +1,276 @@
 #include "00Names.hpp"
 #include "json.hpp"
+#include <map>
+#include <set>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
 
 using namespace std::literals;
 
-static std::string executeWOut(const std::string& command) {
-  std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
-  if (!pipe) error("Failed to execute '%s'!\n", command.c_str());
-  std::string result;
-  char buffer[1024];
-  while (fgets(buffer, sizeof(buffer), pipe.get()) != nullptr) {
-    result += buffer;
+/*          SEARCH INDEX          */
+// 'index.json' next to 'libraries' keeps every repository seen, the results and time of each fetched query and a trigram index of lowercase names
+static std::filesystem::path indexPath() { return libdirPath.parent_path() / "index.json"; }
+
+static std::string lowercase(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+  return str;
+}
+
+static nlohmann::json loadIndex() {
+  std::ifstream file(indexPath());
+  if (!file) return {{"packages", nlohmann::json::array()}, {"queries", nlohmann::json::object()}, {"trigrams", nlohmann::json::object()}};
+  return nlohmann::json::parse(file);
+}
+
+static void saveIndex(nlohmann::json& index) {
+  std::map<std::string, std::vector<size_t>> trigrams;
+  for (size_t i = 0; i < index["packages"].size(); i++) {
+    const std::string name = lowercase(index["packages"][i]["fullName"].get<std::string>());
+    for (size_t j = 0; j + 3 <= name.size(); j++) {
+      auto& postings = trigrams[name.substr(j, 3)];
+      if (postings.empty() || postings.back() != i) postings.push_back(i);
+    }
+  }
+  index["trigrams"] = trigrams;
+  std::ofstream(indexPath()) << index;
+}
+
+// * Adds or updates packages from 'gh search repos' JSON, returns their names
+static std::vector<std::string> mergePackages(nlohmann::json& index, const nlohmann::json& packages) {
+  std::unordered_map<std::string, size_t> known;
+  for (size_t i = 0; i < index["packages"].size(); i++) known[index["packages"][i]["fullName"]] = i;
+
+  std::vector<std::string> names;
+  for (const auto& lib : packages) {
+    nlohmann::json entry = {{"fullName", lib["fullName"]}, {"language", ""}, {"license", ""}, {"description", ""}};
+    if (lib.contains("language") && lib["language"].is_string()) entry["language"] = lib["language"];
+    if (lib.contains("description") && lib["description"].is_string()) entry["description"] = lib["description"];
+    if (lib.contains("license") && lib["license"].is_object() && lib["license"].contains("key")) entry["license"] = lib["license"]["key"];
+    else if (lib.contains("license") && lib["license"].is_string()) entry["license"] = lib["license"];
+
+    if (known.count(entry["fullName"])) index["packages"][known[entry["fullName"]]] = entry;
+    else {
+      known[entry["fullName"]] = index["packages"].size();
+      index["packages"].push_back(entry);
+    }
+    names.push_back(entry["fullName"]);
+  }
+  return names;
+}
+
+void importPackages(const std::string& dump) {
+  std::ifstream file(dump);
+  if (!file) error("Failed to open '%s'!\n", dump.c_str());
+  auto index = loadIndex();
+  const size_t count = mergePackages(index, nlohmann::json::parse(file)).size();
+  saveIndex(index);
+  printf("Imported %zu packages\n", count);
+}
+
+void searchPackage(const std::string& name, const std::vector<std::string>& languages, const std::string& license, bool offline, double ttl) {
+  auto index = loadIndex();
+  const std::string query = lowercase(name);
+  const double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+  // * Refresh the query from GitHub when it's missing or older than the TTL
+  if (!offline && (!index["queries"].contains(query) || now - index["queries"][query]["time"].get<double>() > ttl * 3600)) {
+    const auto response = nlohmann::json::parse(executeWOut("gh search repos \""s + name + "\" --json fullName --json language --json license --json description"s), nullptr, false);
+    if (response.is_array()) {
+      index["queries"][query] = {{"time", now}, {"results", mergePackages(index, response)}};
+      saveIndex(index);
+    } else puts("Warning: 'gh search repos' failed, showing results from the local index!");
+  }
+
+  // * Previous results of this exact query, then every name containing it, narrowed down by trigrams
+  std::vector<size_t> candidates;
+  if (query.size() >= 3) {
+    std::vector<size_t> postings;
+    for (size_t i = 0; i + 3 <= query.size(); i++) {
+      const std::string trigram = query.substr(i, 3);
+      if (!index["trigrams"].contains(trigram)) {
+        postings.clear();
+        break;
+      }
+      std::vector<size_t> next = index["trigrams"][trigram];
+      if (i) {
+        std::vector<size_t> intersection;
+        std::set_intersection(postings.begin(), postings.end(), next.begin(), next.end(), std::back_inserter(intersection));
+        next = intersection;
+      }
+      postings = next;
+    }
+    candidates = postings;
+  } else {
+    for (size_t i = 0; i < index["packages"].size(); i++) candidates.push_back(i);
+  }
+
+  std::set<std::string> results;
+  if (index["queries"].contains(query)) results = index["queries"][query]["results"].get<std::set<std::string>>();
+  for (const auto i : candidates) {
+    const std::string fullName = index["packages"][i]["fullName"];
+    if (lowercase(fullName).find(query) != std::string::npos) results.insert(fullName);
+  }
+
+  std::unordered_map<std::string, const nlohmann::json*> packages;
+  for (const auto& lib : index["packages"]) packages[lib["fullName"]] = &lib;
+  for (const auto& fullName : results) {
+    const auto& lib = *packages[fullName];
+    if (!languages.empty() && std::find(languages.begin(), languages.end(), lib["language"].get<std::string>()) == languages.end()) continue;
+    if (!license.empty() && lowercase(lib["license"]) != lowercase(license)) continue;
+    puts(fullName.c_str());
   }
-  return result;
 }
 
-void searchPackage(const std::string& name) {
-  auto response = nlohmann::json::parse(executeWOut("gh search repos \""s + name + "\" --json fullName --json language --json license"s));
-  for (const auto& lib : response) {
-    std::string language = lib["language"].get<std::string>();
-    if (language != "C" && language != "C++") continue;
-    puts(lib["fullName"].get<std::string>().c_str());
+/*          STORE          */
+// Packages live once per commit in 'store/<owner>/<repo>/<commit>' next to 'libraries', which only holds hard-linked copies
+static std::map<std::string, std::string> readLockfile(const std::filesystem::path& path) {
+  std::map<std::string, std::string> lock;
+  FILE* file = fopen(path.string().c_str(), "r");
+  if (!file) return lock;
+  char name[512], commit[64];
+  while (fscanf(file, "%511s %63s", name, commit) == 2) lock[name] = commit;
+  fclose(file);
+  return lock;
+}
+
+static void writeLockfile(const std::filesystem::path& path, const std::map<std::string, std::string>& lock) {
+  FILE* file = fopen(path.string().c_str(), "w");
+  if (!file) error("Failed to write '%s'!\n", path.string().c_str());
+  for (const auto& [name, commit] : lock) fprintf(file, "%s %s\n", name.c_str(), commit.c_str());
+  fclose(file);
+}
+
+static void linkTree(const std::filesystem::path& from, const std::filesystem::path& to) {
+  std::filesystem::create_directories(to);
+  for (std::filesystem::recursive_directory_iterator i(from), end; i != end; i++) {
+    if (i->path().filename() == ".git") {
+      if (i->is_directory()) i.disable_recursion_pending();
+      continue;
+    }
+    const auto target = to / std::filesystem::relative(i->path(), from);
+    if (i->is_directory()) std::filesystem::create_directories(target);
+    else {
+      std::error_code error;
+      std::filesystem::remove(target, error);
+      std::filesystem::create_hard_link(i->path(), target, error);
+      if (error) std::filesystem::copy_file(i->path(), target);
+    }
+  }
+}
+
+// * Removes what linkTree put in place, files the user added like library.orebuild and the build directory stay
+static void unlinkTree(const std::filesystem::path& from, const std::filesystem::path& to) {
+  std::vector<std::filesystem::path> directories;
+  for (std::filesystem::recursive_directory_iterator i(from), end; i != end; i++) {
+    if (i->path().filename() == ".git") {
+      if (i->is_directory()) i.disable_recursion_pending();
+      continue;
+    }
+    const auto target = to / std::filesystem::relative(i->path(), from);
+    std::error_code error;
+    if (i->is_directory()) directories.push_back(target);
+    else std::filesystem::remove(target, error);
+  }
+  std::sort(directories.rbegin(), directories.rend());
+  for (const auto& directory : directories) {
+    std::error_code error;
+    if (std::filesystem::is_empty(directory, error)) std::filesystem::remove(directory, error);
+  }
+}
+
+// * Fetches missing commits into the store in idempotent steps, renaming '<ref>.partial' only when everything is fetched, so an interrupted install resumes
+void installPackages(std::vector<std::string> names, const std::string& mirror, bool update) {
+  const auto projectPath = std::filesystem::current_path(), lockPath = projectPath / "orebuild.lock";
+  const bool project = std::filesystem::exists(projectPath / "project.orebuild") || std::filesystem::exists(lockPath);
+  auto lock = readLockfile(lockPath);
+  if (names.empty())
+    for (const auto& [name, commit] : lock) names.push_back(name);
+  if (names.empty()) error("Nothing to install, specify packages or run in a project with orebuild.lock!\n");
+
+  const auto storePath = libdirPath.parent_path() / "store";
+  std::filesystem::create_directories(libdirPath);
+  std::filesystem::create_directories(storePath);
+  std::filesystem::current_path(storePath);
+  initJobs("");
+
+  std::map<std::string, std::string> commits, fetched;
+  for (const auto& name : names) {
+    const std::string commit = lock.count(name) && !update ? lock[name] : "";
+    if (!commit.empty() && std::filesystem::exists(storePath / name / commit)) {
+      commits[name] = commit;
+      continue;
+    }
+
+    const std::string ref = commit.empty() ? "HEAD" : commit, partial = (std::filesystem::path(name) / (ref + ".partial")).generic_string();
+    const std::string url = mirror + '/' + name, git = "git -C " + partial + ' ';
+    std::string command = "@git init -q " + partial + " && ";
+    command += "(" + git + "remote add origin " + url + " || " + git + "remote set-url origin " + url + ") && ";
+    command += git + "fetch --depth 1 origin " + ref + " && ";
+    command += git + "-c advice.detachedHead=false checkout -q FETCH_HEAD && ";
+    command += git + "submodule update --init --recursive --depth 1 --jobs " + std::to_string(std::max(jobCount, 1u)) + " && ";
+    command += git + "rev-parse HEAD > " + partial + ".done";
+    printf("Fetching %s %s from %s\n", name.c_str(), ref.c_str(), url.c_str());
+    addJob(command, partial, commit.empty() ? "not installed" : "commit not in the store", JobKind::Fetch);
+    fetched[name] = partial;
   }
+  const bool success = runJobs();
+
+  for (const auto& [name, partial] : fetched) {
+    FILE* done = fopen((partial + ".done").c_str(), "r");
+    if (!done) continue;
+    char commit[64] = {};
+    (void)!fscanf(done, "%63s", commit);
+    fclose(done);
+    std::filesystem::remove(partial + ".done");
+    if (std::filesystem::exists(storePath / name / commit)) std::filesystem::remove_all(partial);
+    else std::filesystem::rename(partial, storePath / name / commit);
+    commits[name] = commit;
+  }
+
+  // * Link the pinned commits into place
+  for (const auto& [name, commit] : commits) {
+    const auto directory = libdirPath / getFilename(name), marker = directory / ".orebuild-commit";
+    if (std::filesystem::exists(directory)) {
+      FILE* file = fopen(marker.string().c_str(), "r");
+      if (!file) {
+        printf("Warning: '%s' is not managed by OreBuild, leaving it alone!\n", directory.string().c_str());
+        continue;
+      }
+      char installed[64] = {};
+      (void)!fscanf(file, "%63s", installed);
+      fclose(file);
+      if (installed == commit) continue;
+      // * Without the old commit in the store, its files are only overwritten
+      if (installed[0] && std::filesystem::exists(storePath / name / installed)) unlinkTree(storePath / name / installed, directory);
+    }
+
+    linkTree(storePath / name / commit, directory);
+    FILE* file = fopen(marker.string().c_str(), "w");
+    if (!file) error("Failed to write '%s'!\n", marker.string().c_str());
+    fprintf(file, "%s\n", commit.c_str());
+    fclose(file);
+    printf("Installed %s at %s\n", name.c_str(), commit.c_str());
+  }
+  for (const auto& [name, commit] : commits) lock[name] = commit;
+
+  std::filesystem::current_path(projectPath);
+  if (project) writeLockfile(lockPath, lock);
+  if (!success) error("Some packages failed to install, run the same command again to resume!\n");
+  if (!fetched.empty()) printf("TODO: add auto-generated library.orebuild, for now go to '%s' and make one yourself!\n", libdirPath.string().c_str());
+}
+
+/*          PREBUILT VARIANTS          */
+void packLibrary(const std::string& name, std::string archive) {
+  const auto variants = std::filesystem::path(name) / "build" / platform / configuration;
+  if (!std::filesystem::exists(libdirPath / variants)) error("No prebuilt variants of '%s' for %s:%s!\n", name.c_str(), platform.c_str(), configuration.c_str());
+  if (archive.empty()) archive = name + '-' + platform + '-' + configuration + ".tar.gz";
+  const std::string command = "tar -czf \"" + std::filesystem::absolute(archive).string() + "\" -C \"" + libdirPath.string() + "\" " + variants.generic_string();
+  if (!execute(command)) exit(-1);
 }
 
-void installPackage(const std::string& name) {
-  if (!std::filesystem::exists(libdirPath)) std::filesystem::create_directories(libdirPath);
-  std::filesystem::current_path(libdirPath);
-  system(("git clone --recursive https://github.com/" + name).c_str());
-  printf("TODO: add auto-generated library.orebuild, for now go to '%s' and make one yourself!\n", libdirPath.string().c_str());
+// * Unpacked objects get the current time, so they count as newer than the library sources
+void unpackLibrary(const std::string& archive) {
+  std::filesystem::create_directories(libdirPath);
+  if (!execute("tar -xzmf \"" + std::filesystem::absolute(archive).string() + "\" -C \"" + libdirPath.string() + '"')) exit(-1);
 }
@@ -41,8 +41,9 @@ static std::vector<std::string> readSplitString(FILE* file, bool split) {
 }
 
 std::unordered_map<std::string, std::vector<std::string>> parseFile(const std::string& filename) {
+  PhaseTimer timer(Phase::Parse);
   std::unordered_map<std::string, std::vector<std::string>> properties;
-  const std::set<std::string> props = {"library", "include", "files", "watch", "output", "flags", "linkerFlags", "compiler"};
+  const std::set<std::string> props = {"library", "include", "files", "watch", "output", "flags", "linkerFlags", "compiler", "debugInfo", "lto", "train", "layout"};
   const std::set<std::string> multiples = {"library", "include", "files", "watch", "flags", "linkerFlags"};
 
   FILE* file = fopen(filename.c_str(), "r");
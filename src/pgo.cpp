@@ -0,0 +1,83 @@
+#include "00Names.hpp"
+#include <set>
+
+/*          PROFILE GUIDED OPTIMIZATION          */
+// `pgo` builds the project instrumented into build/<platform>/<configuration>-instrumented, runs its train command
+// and merges the raw profiles into build/<platform>/<configuration>/profile. Builds use the profile until it's cleaned.
+// GCC keeps a profile per object, so refreshing it only recompiles the objects whose profile changed.
+bool instrument = false;
+
+struct Training {
+  std::string command;
+  std::filesystem::path raw, profile;
+  bool clang;
+};
+static std::vector<Training> trainings;
+
+static std::filesystem::path rawProfiles(const std::filesystem::path& buildDir) { return std::filesystem::absolute(buildDir / "profile-raw"); }
+
+std::string instrumentFlags(const std::filesystem::path& buildDir, bool clang) {
+  // * Without the prefix GCC names profiles after the absolute object path, which differs between the two build directories
+  std::string flags = "-fprofile-generate=" + rawProfiles(buildDir).string();
+  if (!clang) flags += " -fprofile-prefix-path=" + std::filesystem::absolute(buildDir).string();
+  return flags;
+}
+
+std::string profileFlags(const std::filesystem::path& buildDir, bool clang) {
+  const auto profile = std::filesystem::absolute(buildDir / "profile");
+  if (clang) return lastModified(profile / "default.profdata") ? "-fprofile-use=" + (profile / "default.profdata").string() + " -Wno-profile-instr-unprofiled" : "";
+  return lastModified(profile) ? "-fprofile-use=" + profile.string() + " -fprofile-prefix-path=" + std::filesystem::absolute(buildDir).string() + " -Wno-missing-profile" : "";
+}
+
+std::filesystem::path profileData(const std::filesystem::path& buildDir, const std::filesystem::path& object, bool clang) {
+  if (clang) return buildDir / "profile" / "default.profdata";
+  // * GCC mangles the object path without its extension, relative to the prefix
+  return buildDir / "profile" / (replace(object.lexically_relative(buildDir).replace_extension().generic_string(), "/", "#") + ".gcda");
+}
+
+void planTraining(const std::string& command, const std::filesystem::path& buildDir, const std::filesystem::path& profileBuildDir, bool clang) {
+  trainings.push_back(Training{command, rawProfiles(buildDir), std::filesystem::absolute(profileBuildDir / "profile"), clang});
+}
+
+// * Replace only the profiles that changed, unchanged ones keep their time and their objects
+static bool mergeProfiles(const Training& training) {
+  std::filesystem::create_directories(training.profile);
+  if (training.clang) {
+    const auto merged = training.profile / "default.profdata", partial = training.profile / "default.profdata.partial";
+    if (!execute("llvm-profdata merge -o " + partial.string() + ' ' + (training.raw / "*.profraw").string())) return false;
+    if (hashFile(partial) == hashFile(merged)) std::filesystem::remove(partial);
+    else std::filesystem::rename(partial, merged);
+    return true;
+  }
+
+  std::set<std::filesystem::path> trained;
+  if (std::filesystem::exists(training.raw)) {
+    for (const auto& entry : std::filesystem::directory_iterator(training.raw)) {
+      const auto profile = training.profile / entry.path().filename();
+      trained.insert(profile);
+      if (hashFile(entry.path()) != hashFile(profile)) std::filesystem::copy_file(entry.path(), profile, std::filesystem::copy_options::overwrite_existing);
+    }
+  }
+  if (trained.empty()) error("Training produced no profiles in '%s'!\n", training.raw.string().c_str());
+  for (const auto& entry : std::filesystem::directory_iterator(training.profile)) {
+    if (!trained.count(entry.path())) std::filesystem::remove(entry.path());
+  }
+  return true;
+}
+
+bool trainProfiles() {
+  for (const auto& training : trainings) {
+    if (dryRun) {
+      puts(training.command.c_str());
+      continue;
+    }
+    std::filesystem::remove_all(training.raw);
+    if (!execute(training.command)) {
+      printf("Training '%s' failed!\n", training.command.c_str());
+      return false;
+    }
+    if (!mergeProfiles(training)) return false;
+  }
+  trainings.clear();
+  return true;
+}
@@ -0,0 +1,198 @@
+#include "00Names.hpp"
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define REMOTE_UNSUPPORTED
+#else
+#include <unistd.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+/*          REMOTE EXECUTION          */
+// Protocol, one connection per action, text headers followed by raw payloads:
+//   -> HAVE <hash>                           <- YES | NO
+//   -> BLOB <hash> <size>\n<bytes>           <- OK | ERROR
+//   -> RUN <hash> <extension> <size>\n<cmd>  <- DONE <exit code> <object size> <log size>\n<object><log>
+// The command uses $in and $out for the worker's copy of the input and the object it should produce.
+
+std::vector<std::string> remoteWorkers;
+
+#ifndef REMOTE_UNSUPPORTED
+static bool sendAll(int socket, const std::string& data) {
+  for (size_t sent = 0; sent < data.size();) {
+    const ssize_t count = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (count <= 0) return false;
+    sent += count;
+  }
+  return true;
+}
+
+static bool receiveExact(int socket, std::string& data, size_t size) {
+  data.resize(size);
+  for (size_t received = 0; received < size;) {
+    const ssize_t count = recv(socket, data.data() + received, size - received, 0);
+    if (count <= 0) return false;
+    received += count;
+  }
+  return true;
+}
+
+static bool receiveLine(int socket, std::string& line) {
+  line.clear();
+  char c;
+  while (recv(socket, &c, 1, 0) == 1) {
+    if (c == '\n') return true;
+    line += c;
+  }
+  return false;
+}
+
+static std::string readFile(const std::filesystem::path& path) {
+  std::string data;
+  FILE* file = fopen(path.string().c_str(), "rb");
+  if (!file) return data;
+  char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, count);
+  fclose(file);
+  return data;
+}
+
+static bool writeFile(const std::filesystem::path& path, const std::string& data) {
+  FILE* file = fopen(path.string().c_str(), "wb");
+  if (!file) return false;
+  const bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && ok;
+}
+
+// * "host:port", ":port" or "port"
+static addrinfo* resolve(const std::string& address, bool listen) {
+  const size_t colon = address.rfind(':');
+  std::string host = colon == std::string::npos ? "" : address.substr(0, colon);
+  const std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+  if (host.empty() && !listen) host = "localhost";
+
+  addrinfo hints = {}, *result = nullptr;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (listen) hints.ai_flags = AI_PASSIVE;
+  if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0) return nullptr;
+  return result;
+}
+
+static int connectTo(const std::string& address) {
+  addrinfo* addresses = resolve(address, false);
+  int fd = -1;
+  for (addrinfo* info = addresses; info && fd == -1; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd != -1 && connect(fd, info->ai_addr, info->ai_addrlen) == -1) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  if (addresses) freeaddrinfo(addresses);
+  return fd;
+}
+
+/*          WORKER          */
+static void serve(int client, const std::filesystem::path& cache) {
+  std::string line;
+  while (receiveLine(client, line)) {
+    char hash[64] = {};
+    size_t size = 0;
+    if (sscanf(line.c_str(), "HAVE %63s", hash) == 1) {
+      if (!sendAll(client, std::filesystem::exists(cache / hash) ? "YES\n" : "NO\n")) return;
+    } else if (sscanf(line.c_str(), "BLOB %63s %zu", hash, &size) == 2) {
+      std::string data;
+      if (!receiveExact(client, data, size)) return;
+      if (hashData(data) != hash) {
+        sendAll(client, "ERROR hash mismatch\n");
+        return;
+      }
+      const auto partial = cache / (std::string(hash) + ".partial" + std::to_string(getpid()));
+      if (!writeFile(partial, data)) return;
+      std::filesystem::rename(partial, cache / hash);
+      if (!sendAll(client, "OK\n")) return;
+    } else {
+      char extension[16] = {};
+      if (sscanf(line.c_str(), "RUN %63s %15s %zu", hash, extension, &size) != 3) return;
+      std::string command;
+      if (!receiveExact(client, command, size) || !std::filesystem::exists(cache / hash)) return;
+
+      // * Run the action in a private directory, so concurrent actions don't clash
+      const auto directory = cache / ("action" + std::to_string(getpid()));
+      std::filesystem::create_directories(directory);
+      const auto input = directory / (std::string("input") + extension), output = directory / "output.o", log = directory / "output.log";
+      std::filesystem::copy_file(cache / hash, input, std::filesystem::copy_options::overwrite_existing);
+      command = replace(replace(command, "$in", input.string()), "$out", output.string());
+      const int status = system((command + " > " + log.string() + " 2>&1").c_str());
+      const int code = status == -1 || !WIFEXITED(status) ? 1 : WEXITSTATUS(status);
+
+      const std::string object = code == 0 ? readFile(output) : "", messages = readFile(log);
+      sendAll(client, "DONE " + std::to_string(code) + ' ' + std::to_string(object.size()) + ' ' + std::to_string(messages.size()) + '\n' + object + messages);
+      std::filesystem::remove_all(directory);
+      return;
+    }
+  }
+}
+
+void runWorker(const std::string& address, const std::filesystem::path& cache) {
+  std::filesystem::create_directories(cache);
+  addrinfo* addresses = resolve(address, true);
+  if (!addresses) error("Invalid worker address '%s'!\n", address.c_str());
+  const int server = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+  const int reuse = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (server == -1 || bind(server, addresses->ai_addr, addresses->ai_addrlen) == -1 || listen(server, 64) == -1) error("Failed to listen on '%s'!\n", address.c_str());
+  freeaddrinfo(addresses);
+  printf("Worker listening on %s, cache in '%s'\n", address.c_str(), cache.string().c_str());
+  fflush(stdout);
+
+  while (true) {
+    while (waitpid(-1, nullptr, WNOHANG) > 0) continue;
+    const int client = accept(server, nullptr, nullptr);
+    if (client == -1) continue;
+    if (fork() == 0) {
+      close(server);
+      serve(client, cache);
+      close(client);
+      _exit(0);
+    }
+    close(client);
+  }
+}
+
+/*          COORDINATOR          */
+int remoteCompile(const RemoteAction& action, const std::string& worker) {
+  // * Preprocess locally, so the worker needs nothing but the compiler
+  const auto preprocessed = action.output + action.extension;
+  if (system((action.preprocess + " -o " + preprocessed).c_str()) != 0) return 1;
+  const std::string input = readFile(preprocessed), hash = hashData(input);
+  std::filesystem::remove(preprocessed);
+
+  const int socket = connectTo(worker);
+  if (socket == -1) return -1;
+  std::string line;
+  const bool sent = sendAll(socket, "HAVE " + hash + '\n') && receiveLine(socket, line) &&
+                    (line == "YES" || (sendAll(socket, "BLOB " + hash + ' ' + std::to_string(input.size()) + '\n' + input) && receiveLine(socket, line) && line == "OK")) &&
+                    sendAll(socket, "RUN " + hash + ' ' + action.extension + ' ' + std::to_string(action.compile.size()) + '\n' + action.compile);
+  int code = -1;
+  size_t objectSize = 0, logSize = 0;
+  std::string object, messages;
+  if (!sent || !receiveLine(socket, line) || sscanf(line.c_str(), "DONE %d %zu %zu", &code, &objectSize, &logSize) != 3 ||
+      !receiveExact(socket, object, objectSize) || !receiveExact(socket, messages, logSize)) {
+    close(socket);
+    return -1;
+  }
+  close(socket);
+
+  fputs(messages.c_str(), stderr);
+  if (code == 0 && !writeFile(action.output, object)) return 1;
+  return code;
+}
+#else
+void runWorker(const std::string& address, const std::filesystem::path& cache) { error("Workers are not supported on this platform!\n"); }
+int remoteCompile(const RemoteAction& action, const std::string& worker) { return -1; }
+#endif
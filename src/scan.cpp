@@ -0,0 +1,159 @@
+#include "00Names.hpp"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define SCAN_READ
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*          INCLUDE SCANNER          */
+// Finds #include and header unit imports without the preprocessor, to know which headers each source uses before it's compiled.
+// Conditionals and macros are ignored, so it can both miss and invent dependencies. Headers are resolved like the compiler would,
+// against the including directory for quoted names and the include paths, headers found nowhere (the system ones) aren't followed.
+
+struct Directive {
+  std::string name;
+  bool quoted;
+};
+
+struct ScannedFile {
+  std::vector<Directive> directives;
+  uint64_t size = 0;
+};
+
+static const char* findHash(const char* begin, const char* end) {
+#ifdef __SSE2__
+  const __m128i hash = _mm_set1_epi8('#');
+  for (; begin + 16 <= end; begin += 16) {
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)begin), hash));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+#endif
+  const void* found = memchr(begin, '#', end - begin);
+  return found ? (const char*)found : end;
+}
+
+static bool lineStart(const char* begin, const char* position) {
+  while (position > begin && (position[-1] == ' ' || position[-1] == '\t')) position--;
+  return position == begin || position[-1] == '\n';
+}
+
+static const char* skipBlanks(const char* position, const char* end) {
+  while (position < end && (*position == ' ' || *position == '\t')) position++;
+  return position;
+}
+
+static bool readName(const char* position, const char* end, Directive& directive) {
+  if (position >= end || (*position != '"' && *position != '<')) return false;
+  const char close = *position == '"' ? '"' : '>';
+  const char* last = position + 1;
+  while (last < end && *last != close && *last != '\n') last++;
+  if (last >= end || *last != close) return false;
+  directive = Directive{std::string(position + 1, last), close == '"'};
+  return true;
+}
+
+static void scanDirectives(const char* begin, const char* end, ScannedFile& scanned) {
+  Directive directive;
+  for (const char* hash = findHash(begin, end); hash < end; hash = findHash(hash + 1, end)) {
+    if (!lineStart(begin, hash)) continue;
+    const char* word = skipBlanks(hash + 1, end);
+    size_t length = 0;
+    if (end - word > 12 && memcmp(word, "include_next", 12) == 0) length = 12;
+    else if (end - word > 7 && memcmp(word, "include", 7) == 0) length = 7;
+    else if (end - word > 6 && memcmp(word, "import", 6) == 0) length = 6;
+    if (length && readName(skipBlanks(word + length, end), end, directive)) scanned.directives.push_back(directive);
+  }
+
+  // * Header units, import "header"; or import <header>;
+  const char* import = begin;
+  while ((import = (const char*)memmem(import, end - import, "import", 6))) {
+    if (lineStart(begin, import) || (import - begin >= 7 && memcmp(import - 7, "export ", 7) == 0 && lineStart(begin, import - 7))) {
+      if (readName(skipBlanks(import + 6, end), end, directive)) scanned.directives.push_back(directive);
+    }
+    import += 6;
+  }
+}
+
+static const ScannedFile& scanFile(const std::string& path) {
+  static std::unordered_map<std::string, ScannedFile> files;
+  const auto cached = files.find(path);
+  if (cached != files.end()) return cached->second;
+  PhaseTimer timer(Phase::Scan);
+  count(Counter::Scanned);
+  ScannedFile& scanned = files[path];
+#ifdef SCAN_READ
+  std::ifstream stream(path, std::ios::binary);
+  std::stringstream contents;
+  contents << stream.rdbuf();
+  const std::string source = contents.str();
+  scanned.size = source.size();
+  scanDirectives(source.data(), source.data() + source.size(), scanned);
+#else
+  const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat status;
+  if (file == -1) return scanned;
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    scanned.size = status.st_size;
+    void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data != MAP_FAILED) {
+      madvise(data, status.st_size, MADV_SEQUENTIAL);
+      scanDirectives((const char*)data, (const char*)data + status.st_size, scanned);
+      munmap(data, status.st_size);
+    }
+  }
+  close(file);
+#endif
+  return scanned;
+}
+
+// * Existence goes through lastModified, so the build stamp notices headers that appear in front of the ones found
+static std::string resolve(const Directive& directive, const std::filesystem::path& directory, const std::vector<std::filesystem::path>& includePaths) {
+  static std::map<std::tuple<std::string, bool, std::string, std::vector<std::filesystem::path>>, std::string> resolved;
+  const auto key = std::make_tuple(directive.name, directive.quoted, directive.quoted ? directory.string() : "", includePaths);
+  const auto cached = resolved.find(key);
+  if (cached != resolved.end()) return cached->second;
+
+  std::string& result = resolved[key];
+  if (directive.quoted && lastModified(directory / directive.name)) return result = (directory / directive.name).lexically_normal().string();
+  for (const auto& includePath : includePaths) {
+    if (lastModified(includePath / directive.name)) return result = (includePath / directive.name).lexically_normal().string();
+  }
+  return result;
+}
+
+IncludeScan scanIncludes(const std::string& file, const std::vector<std::string>& includes) {
+  std::vector<std::filesystem::path> includePaths;
+  for (const auto& include : includes) includePaths.push_back(std::filesystem::absolute(include));
+
+  IncludeScan scan;
+  std::set<std::string> visited;
+  std::vector<std::string> pending = {std::filesystem::absolute(file).lexically_normal().string()};
+  lastModified(pending[0]);
+  while (!pending.empty()) {
+    const std::string path = pending.back();
+    pending.pop_back();
+    const ScannedFile& scanned = scanFile(path);
+    scan.bytes += scanned.size;
+    const auto directory = std::filesystem::path(path).parent_path();
+    for (const auto& directive : scanned.directives) {
+      const std::string header = resolve(directive, directory, includePaths);
+      if (header.empty() || !visited.insert(header).second) continue;
+      scan.headers.push_back(header);
+      pending.push_back(header);
+    }
+  }
+  return scan;
+}
@@ -0,0 +1,52 @@
+#include "00Names.hpp"
+#include <chrono>
+#include <map>
+
+/*          STATS          */
+bool showStats = false;
+
+static const char* phaseNames[] = {"other", "parse buildfiles", "expand globs", "stat files", "scan includes", "assemble commands", "wait for compilers", "wait for linker"};
+static const char* counterNames[] = {"directory entries visited", "glob matches attempted", "stats issued", "files scanned for includes", "processes spawned", "command line bytes"};
+
+static double phaseTimes[(size_t)Phase::Count];
+static uint64_t counters[(size_t)Counter::Count];
+static std::map<std::string, double> globTimes;
+
+// * Phases are exclusive: a nested phase pauses the one it interrupts
+static Phase currentPhase = Phase::Other;
+static auto phaseStart = std::chrono::steady_clock::now();
+
+static void switchPhase(Phase phase) {
+  const auto now = std::chrono::steady_clock::now();
+  phaseTimes[(size_t)currentPhase] += std::chrono::duration<double>(now - phaseStart).count();
+  currentPhase = phase;
+  phaseStart = now;
+}
+
+PhaseTimer::PhaseTimer(Phase phase, const std::string& pattern) : previous(currentPhase), pattern(pattern) {
+  if (!showStats) return;
+  if (!pattern.empty()) start = phaseTimes[(size_t)phase];
+  switchPhase(phase);
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (!showStats) return;
+  const Phase phase = currentPhase;
+  switchPhase(previous);
+  if (!pattern.empty()) globTimes[pattern] += phaseTimes[(size_t)phase] - start;
+}
+
+void count(Counter counter, uint64_t amount) { counters[(size_t)counter] += amount; }
+
+void printStats() {
+  if (!showStats) return;
+  switchPhase(currentPhase);
+  puts("Phases:");
+  for (size_t i = 0; i < (size_t)Phase::Count; i++) {
+    printf("  %-24s %10.3f ms\n", phaseNames[i], phaseTimes[i] * 1000);
+    if ((Phase)i != Phase::Glob) continue;
+    for (const auto& [pattern, time] : globTimes) printf("    %-22s %10.3f ms\n", pattern.c_str(), time * 1000);
+  }
+  puts("Counters:");
+  for (size_t i = 0; i < (size_t)Counter::Count; i++) printf("  %-26s %10lu\n", counterNames[i], counters[i]);
+}
@@ -1,5 +1,9 @@
 #include "00Names.hpp"
 #include <regex>
+#include <fstream>
+#include <cstring>
+#include <map>
+#include <tuple>
 
 /*          WILDCARD          */
 std::string replace(std::string str, const std::string& from, const std::string& to) {
@@ -13,23 +17,135 @@ std::string replace(std::string str, const std::string& from, const std::string&
 }
 
 bool wildcardMatch(const std::string& str, const std::string& pattern) {
+  count(Counter::Matches);
   std::regex specialChars{R"([-[\]{}()+.,\^$|#])"};
   return std::regex_match(str, std::regex(replace(replace(replace(std::string(std::regex_replace(pattern, specialChars, R"(\$&)")), "?", "."), "**", ".+"), "*", "[^/]+")));
 }
 
-std::vector<std::string> wildcard(const std::string& pattern, bool dir) {
+// Globs never look into version control metadata, the build directories next to buildfiles, and what the .orebuildignore
+// of the buildfile directory lists. It takes gitignore patterns: * ? [] and **, a trailing / for directories, ! to take one back.
+struct IgnoreRule {
+  std::regex pattern;
+  bool negated, directoryOnly;
+};
+
+static std::regex ignorePattern(std::string pattern) {
+  // * Patterns with a slash are relative to the ignore file, others match at any depth
+  const bool anchored = pattern.find('/') != std::string::npos;
+  if (pattern[0] == '/') pattern.erase(0, 1);
+  std::string regex = anchored ? "" : "(.*/)?";
+  const auto literal = [&](char c) {
+    if (strchr(".^$|()[]{}+*?\\", c)) regex += '\\';
+    regex += c;
+  };
+  for (size_t i = 0; i < pattern.size(); i++) {
+    const size_t close = pattern[i] == '[' ? pattern.find(']', i + 2) : std::string::npos;
+    if (pattern.compare(i, 3, "**/") == 0) regex += "(.*/)?", i += 2;
+    else if (pattern.compare(i, 2, "**") == 0) regex += ".*", i++;
+    else if (pattern[i] == '*') regex += "[^/]*";
+    else if (pattern[i] == '?') regex += "[^/]";
+    else if (close != std::string::npos) {
+      std::string set = pattern.substr(i + 1, close - i - 1);
+      if (set[0] == '!') set[0] = '^';
+      regex += '[' + replace(set, "\\", "\\\\") + ']';
+      i = close;
+    } else if (pattern[i] == '\\' && i + 1 < pattern.size()) literal(pattern[++i]);
+    else literal(pattern[i]);
+  }
+  return std::regex(regex);
+}
+
+static const std::vector<IgnoreRule>& ignoreRules() {
+  static std::map<std::string, std::vector<IgnoreRule>> rules;
+  const std::string directory = std::filesystem::current_path().string();
+  if (rules.count(directory)) return rules[directory];
+  std::vector<IgnoreRule>& result = rules[directory];
+  if (!lastModified(".orebuildignore")) return result;
+  std::ifstream file(".orebuildignore");
+  for (std::string line; std::getline(file, line);) {
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ') && !(line.size() > 1 && line[line.size() - 2] == '\\')) line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    const bool negated = line[0] == '!';
+    if (negated) line.erase(0, 1);
+    const bool directoryOnly = !line.empty() && line.back() == '/';
+    if (directoryOnly) line.pop_back();
+    if (!line.empty()) result.push_back(IgnoreRule{ignorePattern(line), negated, directoryOnly});
+  }
+  return result;
+}
+
+static bool ignored(const std::filesystem::path& entry, const std::string& path, bool isDirectory) {
+  if (isDirectory) {
+    const std::string name = entry.filename().string();
+    if (name == ".git" || name == ".hg" || name == ".svn" || name == ".bzr") return true;
+    if (name == "build" && (lastModified(entry.parent_path() / "project.orebuild") || lastModified(entry.parent_path() / "library.orebuild"))) return true;
+  }
+  // * The last rule that matches decides
+  bool result = false;
+  for (const auto& rule : ignoreRules()) {
+    if ((isDirectory || !rule.directoryOnly) && std::regex_match(path, rule.pattern)) result = !rule.negated;
+  }
+  return result;
+}
+
+// * A negation ending in /** takes back a whole directory, which isn't walked then
+static bool excludedDirectory(const std::string& path, const std::vector<std::string>& exclude) {
+  for (const auto& pattern : exclude) {
+    if (pattern.size() < 3 || pattern.compare(pattern.size() - 3, 3, "/**") != 0) continue;
+    const std::string directory = pattern.substr(0, pattern.size() - 3);
+    if (directory.find_first_of("*?") == std::string::npos ? path == directory : wildcardMatch(path, directory)) return true;
+  }
+  return false;
+}
+
+static bool excluded(const std::string& path, const std::vector<std::string>& exclude) {
+  for (const auto& pattern : exclude) {
+    if (pattern.find_first_of("*?") == std::string::npos ? path == pattern : wildcardMatch(path, pattern)) return true;
+  }
+  return false;
+}
+
+// * Expansions are shared by every configuration built in this run
+std::vector<std::string> wildcard(const std::string& pattern, bool dir, const std::vector<std::string>& exclude) {
+  PhaseTimer timer(Phase::Glob, pattern);
+  static std::map<std::tuple<std::string, std::string, bool, std::vector<std::string>>, std::vector<std::string>> expanded;
+  const auto key = std::make_tuple(std::filesystem::current_path().string(), pattern, dir, exclude);
+  if (expanded.count(key)) return expanded[key];
   std::vector<std::string> result;
   size_t wildcardStart = pattern.find_first_of("*?");
-  if (wildcardStart == std::string::npos) return std::vector<std::string>{pattern};
+  if (wildcardStart == std::string::npos) return excluded(pattern, exclude) ? std::vector<std::string>{} : std::vector<std::string>{pattern};
   std::string parent = pattern.substr(0, pattern.find_last_of("/\\", wildcardStart));
   if (parent.length() == pattern.length()) parent = ".";
+  // * Directory times go into the build stamp, so added and removed files are noticed. The entry types come with the
+  // directory listing, and the directories are stated together once it's done
+  std::vector<std::string> directories = {parent};
   for (std::filesystem::recursive_directory_iterator i(parent), end; i != end; i++) {
-    if (is_directory(i->path()) == dir) {
-      std::string path = i->path().string();
-      replace(path.begin(), path.end(), '\\', '/');
-      if (path.substr(0, 2) == "./") path = path.substr(2);
-      if (wildcardMatch(path, pattern)) result.push_back(path);
+    count(Counter::Entries);
+    const bool isDirectory = i->is_directory();
+    std::string path = i->path().string();
+    replace(path.begin(), path.end(), '\\', '/');
+    if (path.substr(0, 2) == "./") path = path.substr(2);
+    if (ignored(i->path(), path, isDirectory) || (isDirectory && excludedDirectory(path, exclude))) {
+      if (isDirectory) i.disable_recursion_pending();
+      continue;
     }
+    if (isDirectory) directories.push_back(i->path().string());
+    if (isDirectory == dir && wildcardMatch(path, pattern) && !excluded(path, exclude)) result.push_back(path);
+  }
+  prefetchModified(directories);
+  return expanded[key] = result;
+}
+
+// * Patterns starting with ! take back what the others matched
+std::vector<std::string> wildcards(const std::vector<std::string>& patterns, bool dir) {
+  std::vector<std::string> exclude, result;
+  for (const auto& pattern : patterns) {
+    if (pattern[0] == '!') exclude.push_back(pattern.substr(1));
+  }
+  for (const auto& pattern : patterns) {
+    if (pattern[0] == '!') continue;
+    const std::vector<std::string> found = wildcard(pattern, dir, exclude);
+    result.insert(result.end(), found.begin(), found.end());
   }
   return result;
 }